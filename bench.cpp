@@ -0,0 +1,364 @@
+#include "gameSimpleRender.hpp"
+#include "fixedModel.hpp"
+#include "quantizedModel.hpp"
+#include "noiseTable.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+
+/*
+Micro benchmarks for the hot loops of training and inference.
+
+Every benchmark runs once per SIMD level the CPU supports, so the speedup of each kernel set
+over the scalar code can be read straight off the table.
+*/
+
+// Average nanoseconds per call of fn, run for at least minSeconds
+double timeNs(const std::function<void()> &fn, double minSeconds = 0.2)
+{
+    using Clock = std::chrono::steady_clock;
+    long calls = 0;
+    const auto start = Clock::now();
+    double elapsed = 0.0;
+    while (elapsed < minSeconds)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            fn();
+        }
+        calls += 64;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    return elapsed * 1e9 / (double)calls;
+}
+
+// One row of the table: the benchmark at every supported SIMD level, as ns per call and speedup over scalar
+void benchAllLevels(const std::string &name, const std::function<void()> &fn)
+{
+    const SimdLevel supportedLevel = detectSimdLevel();
+    std::cout << std::left << std::setw(36) << name;
+    double scalarNs = 0.0;
+    for (int level = SIMD_SCALAR; level <= supportedLevel; level++)
+    {
+        setSimdLevel((SimdLevel)level);
+        const double ns = timeNs(fn);
+        if (level == SIMD_SCALAR)
+        {
+            scalarNs = ns;
+        }
+        std::ostringstream cell;
+        cell << std::fixed << std::setprecision(1) << ns << " (" << scalarNs / ns << "x)";
+        std::cout << std::setw(20) << cell.str();
+    }
+    std::cout << std::endl;
+    setSimdLevel(supportedLevel);
+}
+
+void printHeader(const std::string &title)
+{
+    std::cout << std::endl
+              << std::left << std::setw(36) << title;
+    for (int level = SIMD_SCALAR; level <= detectSimdLevel(); level++)
+    {
+        std::cout << std::setw(20) << getSimdLevelName((SimdLevel)level);
+    }
+    std::cout << std::endl;
+}
+
+void benchKernels(int boardSize, int hiddenSize)
+{
+    uint32_t randSeed = 42;
+    SnakeModel model = SnakeModel(boardSize, hiddenSize);
+    model.setRand(randSeed, 0.1f);
+    SnakeGame game = SnakeGame(boardSize, randSeed);
+    for (int i = 0; i < boardSize; i++)
+    {
+        game.step(SnakeActions::NO_TURN, randSeed);
+    }
+    const uint8_t *board = game.getBoard();
+    HiddenAccumulator accumulator = HiddenAccumulator(hiddenSize);
+    accumulator.refresh(model.weight0, board);
+    Matrix out = Matrix(1, 3);
+
+    const int numParams = model.getNumParams();
+    Matrix a = Matrix(1, numParams);
+    Matrix b = Matrix(1, numParams);
+    a.setRand(randSeed, 1.0f);
+    b.setRand(randSeed, 1.0f);
+    Matrix grad = Matrix(1, numParams);
+    AdamOptimizer adam = AdamOptimizer(numParams, 1e-2f);
+    const NoiseTable noiseTable = NoiseTable(1 << 22, 42);
+
+    const std::string suffix = " (" + std::to_string(boardSize) + "x" + std::to_string(boardSize) + ", hidden " + std::to_string(hiddenSize) + ")";
+    printHeader("ns per call" + suffix);
+    benchAllLevels("forward", [&]
+                   { model.forward(board, game.applePosition, out); });
+    benchAllLevels("forward from accumulator", [&]
+                   { model.forward(accumulator, game.applePosition, out); });
+    benchAllLevels("accumulator move", [&]
+                   { accumulator.move(model.weight0, 0, 1, 3); });
+    benchAllLevels("Matrix::add (" + std::to_string(numParams) + ")", [&]
+                   { a.add(b); });
+    benchAllLevels("Matrix::mul", [&]
+                   { a.mul(1.0f); });
+    benchAllLevels("Matrix::diffSquared", [&]
+                   { volatile float sink = a.diffSquared(b); (void)sink; });
+    benchAllLevels("Matrix::addRand (randDist)", [&]
+                   { a.addRand(randSeed, 0.1f); });
+    benchAllLevels("Matrix::addRand (fastNoise)", [&]
+                   { a.addRand(randSeed, 0.1f, true); });
+    benchAllLevels("NoiseTable::addNoise", [&]
+                   { noiseTable.addNoise(a, noiseTable.samplePerturbation(randSeed, numParams), 0.1f); });
+    benchAllLevels("AdamOptimizer::getGrads", [&]
+                   {
+                       grad.copy(b);
+                       adam.getGrads(grad); });
+}
+
+// SnakeModel::forward against FixedSnakeModel::forward for the same weights and board
+template <int Size, int Hidden>
+void benchFixed()
+{
+    uint32_t randSeed = 42;
+    SnakeModel model = SnakeModel(Size, Hidden);
+    model.setRand(randSeed, 0.1f);
+    std::unique_ptr<FixedSnakeModel<Size, Hidden>> fixedModel = std::make_unique<FixedSnakeModel<Size, Hidden>>();
+    fixedModel->copyWeights(model);
+    SnakeGame game = SnakeGame(Size, randSeed);
+    for (int i = 0; i < Size; i++)
+    {
+        game.step(SnakeActions::NO_TURN, randSeed);
+    }
+    const uint8_t *board = game.getBoard();
+    HiddenAccumulator accumulator = HiddenAccumulator(Hidden);
+    accumulator.refresh(model.weight0, board);
+    Matrix out = Matrix(1, 3);
+
+    printHeader("ns per call (" + std::to_string(Size) + "x" + std::to_string(Size) + ", hidden " + std::to_string(Hidden) + ")");
+    benchAllLevels("SnakeModel forward", [&]
+                   { model.forward(board, game.applePosition, out); });
+    benchAllLevels("FixedSnakeModel forward", [&]
+                   { fixedModel->forward(board, game.applePosition, out); });
+    benchAllLevels("SnakeModel from accumulator", [&]
+                   { model.forward(accumulator, game.applePosition, out); });
+    benchAllLevels("FixedSnakeModel from accumulator", [&]
+                   { fixedModel->forward(accumulator, game.applePosition, out); });
+}
+
+// SnakeModel::forward against QuantizedSnakeModel::forward, cycling through boards so the weight rows touched change every call
+void benchQuantized(int boardSize, int hiddenSize)
+{
+    uint32_t randSeed = 42;
+    SnakeModel model = SnakeModel(boardSize, hiddenSize);
+    model.setRand(randSeed, 0.1f);
+    QuantizedSnakeModel quantizedModel = QuantizedSnakeModel(model);
+    const int numCells = boardSize * boardSize;
+    const int numBoards = 256;
+
+    std::vector<uint8_t> boards(numBoards * numCells);
+    std::vector<int> applePositions(numBoards);
+    for (int b = 0; b < numBoards; b++)
+    {
+        SnakeGame game = SnakeGame(boardSize, randSeed);
+        const int numSteps = (int)randInt(randSeed, boardSize);
+        for (int i = 0; i < numSteps; i++)
+        {
+            game.step(SnakeActions::NO_TURN, randSeed);
+        }
+        std::memcpy(&boards[b * numCells], game.getBoard(), numCells);
+        applePositions[b] = game.applePosition;
+    }
+    Matrix out = Matrix(1, 3);
+    int board = 0;
+
+    printHeader("ns per call (" + std::to_string(boardSize) + "x" + std::to_string(boardSize) + ", hidden " + std::to_string(hiddenSize) + ")");
+    benchAllLevels("float forward (" + std::to_string(model.getNumParams() * sizeof(float) / 1024) + " KB)", [&]
+                   {
+                       model.forward(&boards[board * numCells], applePositions[board], out);
+                       board = (board + 1) % numBoards; });
+    benchAllLevels("int8 forward (" + std::to_string(quantizedModel.getNumBytes() / 1024) + " KB)", [&]
+                   {
+                       quantizedModel.forward(&boards[board * numCells], applePositions[board], out);
+                       board = (board + 1) % numBoards; });
+
+    // One game step on each accumulator, a move and a forward. The snake circles a 2x2 block at length 3,
+    // so the accumulators stay at real boards however many moves are timed
+    const int circle[4] = {0, 1, boardSize + 1, boardSize};
+    std::vector<uint8_t> circleBoard(numCells, 0);
+    for (int i = 0; i < 3; i++)
+    {
+        circleBoard[circle[i]] = (uint8_t)(i + 1);
+    }
+    const int circleApple = numCells - 1;
+    HiddenAccumulator accumulator = HiddenAccumulator(hiddenSize);
+    QuantizedHiddenAccumulator quantizedAccumulator = QuantizedHiddenAccumulator(hiddenSize);
+    accumulator.refresh(model.weight0, circleBoard.data());
+    quantizedAccumulator.refresh(quantizedModel.weight0, circleBoard.data());
+    int circleStep = 0;
+    benchAllLevels("float accumulator step", [&]
+                   {
+                       accumulator.move(model.weight0, circle[circleStep], circle[(circleStep + 3) % 4], 3);
+                       model.forward(accumulator, circleApple, out);
+                       circleStep = (circleStep + 1) % 4; });
+    benchAllLevels("int8 accumulator step", [&]
+                   {
+                       quantizedAccumulator.move(quantizedModel.weight0, circle[circleStep], circle[(circleStep + 3) % 4], 3);
+                       quantizedModel.forward(quantizedAccumulator, circleApple, out);
+                       circleStep = (circleStep + 1) % 4; });
+}
+
+// sampleAction against sampleActionFast and the batched sampleActions, in ns per sampled action
+void benchSampling()
+{
+    const int numGames = 1024;
+    uint32_t randSeed = 42;
+    Matrix logits = Matrix(numGames, 3);
+    logits.setRand(randSeed, 2.0f);
+    std::vector<uint32_t> randSeeds(numGames);
+    for (int i = 0; i < numGames; i++)
+    {
+        randSeeds[i] = PCG_Hash(i);
+    }
+    std::vector<int32_t> actions(numGames);
+    Matrix out = Matrix(1, 3);
+    int game = 0;
+    volatile int sink = 0;
+
+    printHeader("ns per sampled action");
+    benchAllLevels("sampleAction (softmax)", [&]
+                   {
+                       // sampleAction overwrites out with the probabilities
+                       out.values[0] = logits.values[game * 3];
+                       out.values[1] = logits.values[game * 3 + 1];
+                       out.values[2] = logits.values[game * 3 + 2];
+                       sink = sampleAction(out, randSeeds[game]);
+                       game = (game + 1) % numGames; });
+    benchAllLevels("sampleActionFast", [&]
+                   {
+                       out.values[0] = logits.values[game * 3];
+                       out.values[1] = logits.values[game * 3 + 1];
+                       out.values[2] = logits.values[game * 3 + 2];
+                       sink = sampleActionFast(out, randSeeds[game]);
+                       game = (game + 1) % numGames; });
+    benchAllLevels("sampleActions (per game of " + std::to_string(numGames) + ")", [&]
+                   {
+                       // One call in numGames does the whole batch
+                       if (game == 0)
+                       {
+                           sampleActions(logits, randSeeds.data(), nullptr, numGames, actions.data());
+                       }
+                       sink = actions[game];
+                       game = (game + 1) % numGames; });
+    (void)sink;
+}
+
+/*
+Chi-square goodness of fit of the batched sampler against the exact softmax probabilities, for a few
+logit vectors from flat to nearly deterministic, at every SIMD level. With 2 degrees of freedom the
+statistic stays under 13.82 with probability 0.999 if the sampled distribution is the softmax.
+*/
+void checkSamplingDistribution()
+{
+    const int numGames = 1024;
+    const int numRounds = 1000;
+    const float testLogits[][3] = {{0.0f, 0.0f, 0.0f}, {1.0f, -1.0f, 0.5f}, {4.0f, -3.0f, 0.0f}, {-20.0f, 0.0f, 0.1f}, {2.5f, 2.5f, -6.0f}};
+
+    std::cout << std::endl
+              << std::left << std::setw(36) << "chi-square, 2 dof (pass < 13.82)";
+    for (int level = SIMD_SCALAR; level <= detectSimdLevel(); level++)
+    {
+        std::cout << std::setw(20) << getSimdLevelName((SimdLevel)level);
+    }
+    std::cout << std::endl;
+
+    for (const float *l : testLogits)
+    {
+        // Expected probabilities in double
+        const double maxLogit = std::max(l[0], std::max(l[1], l[2]));
+        double expected[3];
+        double sum = 0.0;
+        for (int c = 0; c < 3; c++)
+        {
+            expected[c] = std::exp((double)l[c] - maxLogit);
+            sum += expected[c];
+        }
+
+        std::ostringstream name;
+        name << "logits (" << l[0] << ", " << l[1] << ", " << l[2] << ")";
+        std::cout << std::setw(36) << name.str();
+        const SimdLevel supportedLevel = detectSimdLevel();
+        for (int level = SIMD_SCALAR; level <= supportedLevel; level++)
+        {
+            setSimdLevel((SimdLevel)level);
+            Matrix logits = Matrix(numGames, 3);
+            for (int i = 0; i < numGames; i++)
+            {
+                logits.values[i * 3] = l[0];
+                logits.values[i * 3 + 1] = l[1];
+                logits.values[i * 3 + 2] = l[2];
+            }
+            std::vector<uint32_t> randSeeds(numGames);
+            for (int i = 0; i < numGames; i++)
+            {
+                randSeeds[i] = PCG_Hash(i * 7919u + 17u);
+            }
+            std::vector<int32_t> actions(numGames);
+            long counts[3] = {0, 0, 0};
+            for (int round = 0; round < numRounds; round++)
+            {
+                sampleActions(logits, randSeeds.data(), nullptr, numGames, actions.data());
+                for (int i = 0; i < numGames; i++)
+                {
+                    counts[actions[i]]++;
+                }
+            }
+
+            // Actions with an expected count under 5 are pooled into the next one, as the test requires
+            const double numSamples = (double)numGames * numRounds;
+            double chiSquare = 0.0;
+            double pooledExpected = 0.0;
+            double pooledObserved = 0.0;
+            for (int c = 0; c < 3; c++)
+            {
+                pooledExpected += numSamples * expected[c] / sum;
+                pooledObserved += (double)counts[c];
+                if (pooledExpected >= 5.0 || c == 2)
+                {
+                    chiSquare += (pooledObserved - pooledExpected) * (pooledObserved - pooledExpected) / pooledExpected;
+                    pooledExpected = 0.0;
+                    pooledObserved = 0.0;
+                }
+            }
+            std::ostringstream cell;
+            cell << std::fixed << std::setprecision(2) << chiSquare << (chiSquare < 13.82 ? " ok" : " FAIL");
+            std::cout << std::setw(20) << cell.str();
+        }
+        setSimdLevel(supportedLevel);
+        std::cout << std::endl;
+    }
+}
+
+int main()
+{
+    std::cout << "Detected SIMD level: " << getSimdLevelName(detectSimdLevel()) << std::endl;
+
+    benchKernels(4, 32);
+    benchKernels(4, 256);
+    benchKernels(8, 1024);
+
+    benchFixed<4, 32>();
+    benchFixed<4, 256>();
+    benchFixed<8, 1024>();
+
+    benchQuantized(4, 32);
+    benchQuantized(4, 256);
+    benchQuantized(8, 1024);
+    benchQuantized(16, 1024);
+
+    benchSampling();
+    checkSamplingDistribution();
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef CRC32_HPP
+#define CRC32_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+CRC-32 with the zlib / PNG polynomial, for catching truncated or corrupted files.
+
+Table driven, one byte per step. Pass the previous result as crc to continue over more data.
+*/
+
+std::array<uint32_t, 256> makeCrc32Table()
+{
+    std::array<uint32_t, 256> table;
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t value = i;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0)
+{
+    static const std::array<uint32_t, 256> table = makeCrc32Table();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+#endif
@@ -0,0 +1 @@
+g++ -O3 bench.cpp -o bench -Wall -Wextra -static
\ No newline at end of file
@@ -0,0 +1 @@
+g++ -O3 solve.cpp -o solve -Wall -Wextra -static
\ No newline at end of file
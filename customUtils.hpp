@@ -1,4 +1,5 @@
-#ifndef NEURAL_NET_HPP
+#ifndef CUSTOM_UTILS_HPP
+#define CUSTOM_UTILS_HPP
 
 #include <iostream>
 
@@ -0,0 +1,284 @@
+#ifndef ES_CLUSTER_HPP
+#define ES_CLUSTER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "neuralNet.hpp"
+#include "socketConnection.hpp"
+
+/*
+Evolution strategies spread over processes, passing only seeds and scores.
+
+A coordinator and any number of workers run the same training loop on identical copies of the
+model. Each step the coordinator sends every worker its range of trials with the step's noise and
+game seeds. Workers rebuild those trials' perturbations from the seeds, play them, and send back
+one score per trial. The coordinator then sends all nTrials scores to every worker. From there
+every process normalizes the same scores and builds the same update from the same seeds, so a step
+costs O(nTrials) bytes on the wire whatever the number of parameters. Only the starting weights are
+sent in full, once.
+
+Processes stay in sync only while they round identically, so they should be the same build running
+at the same SIMD level. Every result carries a CRC of the worker's weights, and the coordinator
+drops a worker on the first step where it no longer matches its own, or once its connection is
+lost. The coordinator plays a dropped worker's trials itself and splits them over the workers
+left from the next step on.
+*/
+
+const uint32_t ES_CLUSTER_MAGIC = 0x53454B53; // "SKES"
+
+// Worker to coordinator on connect, the coordinator refuses a worker whose settings differ
+struct EsHelloMessage
+{
+    uint32_t magic = ES_CLUSTER_MAGIC;
+    uint32_t numParams = 0;
+    uint32_t nTrials = 0;
+    uint32_t settingsCrc = 0; // Of the run's config.txt text
+};
+
+// Coordinator to worker at the start of every step
+struct EsStepMessage
+{
+    uint32_t stepNum = 0;
+    uint32_t trialBegin = 0;
+    uint32_t trialEnd = 0;
+    uint32_t randSeed = 0;     // Noise seed the step's trial seeds are hashed from
+    uint32_t gameRandSeed = 0; // Game seed the step's chunk seeds are hashed from
+};
+
+// Worker to coordinator, followed by trialEnd - trialBegin float scores
+struct EsResultMessage
+{
+    uint32_t stepNum = 0;
+    uint32_t paramsCrc = 0; // Of the weights the step started from
+};
+
+inline uint32_t getParamsCrc(const Matrix &params)
+{
+    return crc32((const uint8_t *)params.values, (size_t)params.numValues * sizeof(float));
+}
+
+struct EsCoordinator
+{
+    SocketListener listener;
+    std::vector<SocketConnection> workers;
+    std::vector<int> workerIds;   // Order each worker connected in, for messages
+    std::vector<uint8_t> lost;    // Workers dropped during the current step
+    std::vector<int> trialBegins; // Worker i plays trials [trialBegins[i], trialBegins[i + 1])
+    EsHelloMessage hello;
+    bool pairTrials;
+
+    // Waits for numWorkers workers with the same settings and sends each the starting weights, a worker that fails the
+    // hello is turned away and another waited for. Trials are split in pairs when pairTrials is set, so both halves of
+    // an antithetic pair stay on one worker
+    EsCoordinator(int port, int numWorkers, const EsHelloMessage &_hello, const Matrix &params, bool _pairTrials)
+        : listener(port), hello(_hello), pairTrials(_pairTrials)
+    {
+        int numConnected = 0;
+        while ((int)workers.size() < numWorkers)
+        {
+            SocketConnection worker = listener.accept();
+            const int workerId = numConnected++;
+            try
+            {
+                const EsHelloMessage workerHello = worker.receive<EsHelloMessage>();
+                const uint32_t accepted = workerHello.magic == hello.magic && workerHello.numParams == hello.numParams &&
+                                          workerHello.nTrials == hello.nTrials && workerHello.settingsCrc == hello.settingsCrc;
+                worker.send(accepted);
+                if (!accepted)
+                {
+                    std::cout << "Worker " << workerId << " was built with different settings, turned away" << std::endl;
+                    continue;
+                }
+                worker.sendAll(params.values, (size_t)params.numValues * sizeof(float));
+            }
+            catch (const std::runtime_error &error)
+            {
+                std::cout << "Worker " << workerId << " lost while joining: " << error.what() << std::endl;
+                continue;
+            }
+            workers.push_back(std::move(worker));
+            workerIds.push_back(workerId);
+            std::cout << "Worker " << workerId << " connected" << std::endl;
+        }
+        lost = std::vector<uint8_t>(workers.size(), 0);
+        splitTrials();
+    }
+
+    void splitTrials()
+    {
+        const int numWorkers = (int)workers.size();
+        const int trialsPerUnit = pairTrials ? 2 : 1;
+        const int numUnits = (int)hello.nTrials / trialsPerUnit;
+        trialBegins.clear();
+        for (int i = 0; i <= numWorkers; i++)
+        {
+            trialBegins.push_back(numWorkers > 0 ? numUnits * i / numWorkers * trialsPerUnit : 0);
+        }
+        for (int i = 0; i < numWorkers; i++)
+        {
+            std::cout << "Worker " << workerIds[i] << " plays trials [" << trialBegins[i] << ", " << trialBegins[i + 1] << ")" << std::endl;
+        }
+    }
+
+    void dropWorker(int i, const std::string &reason)
+    {
+        std::cout << "Worker " << workerIds[i] << " dropped, " << reason << std::endl;
+        workers[i].close();
+        lost[i] = 1;
+    }
+
+    // One step: hands out the trials, gathers every score into scores and sends them all back out. A worker that has
+    // gone or diverged is dropped, playTrials(trialBegin, trialEnd) plays its trials here instead, and the workers left
+    // share its trials from the next step on. With none left every trial is played here
+    template <typename PlayTrials>
+    void runStep(int stepNum, uint32_t randSeed, uint32_t gameRandSeed, const Matrix &params, float *scores, PlayTrials &&playTrials)
+    {
+        if (workers.empty())
+        {
+            playTrials(0, (int)hello.nTrials);
+            return;
+        }
+
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            EsStepMessage step;
+            step.stepNum = (uint32_t)stepNum;
+            step.trialBegin = (uint32_t)trialBegins[i];
+            step.trialEnd = (uint32_t)trialBegins[i + 1];
+            step.randSeed = randSeed;
+            step.gameRandSeed = gameRandSeed;
+            try
+            {
+                workers[i].send(step);
+            }
+            catch (const std::runtime_error &error)
+            {
+                dropWorker((int)i, error.what());
+            }
+        }
+
+        const uint32_t paramsCrc = getParamsCrc(params);
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            if (lost[i])
+            {
+                continue;
+            }
+            try
+            {
+                const EsResultMessage result = workers[i].receive<EsResultMessage>();
+                if (result.stepNum != (uint32_t)stepNum || result.paramsCrc != paramsCrc)
+                {
+                    dropWorker((int)i, "it has diverged from the coordinator at step " + std::to_string(stepNum));
+                    continue;
+                }
+                workers[i].receiveAll(&scores[trialBegins[i]], (size_t)(trialBegins[i + 1] - trialBegins[i]) * sizeof(float));
+            }
+            catch (const std::runtime_error &error)
+            {
+                dropWorker((int)i, error.what());
+            }
+        }
+
+        // Trials are seeded by index, so they score the same here as on the worker that was meant to play them
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            if (lost[i])
+            {
+                playTrials(trialBegins[i], trialBegins[i + 1]);
+            }
+        }
+
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            if (lost[i])
+            {
+                continue;
+            }
+            try
+            {
+                workers[i].sendAll(scores, hello.nTrials * sizeof(float));
+            }
+            catch (const std::runtime_error &error)
+            {
+                dropWorker((int)i, error.what());
+            }
+        }
+
+        // Split the trials again over the workers left
+        if (std::find(lost.begin(), lost.end(), 1) != lost.end())
+        {
+            for (int i = (int)workers.size() - 1; i >= 0; i--)
+            {
+                if (lost[i])
+                {
+                    workers.erase(workers.begin() + i);
+                    workerIds.erase(workerIds.begin() + i);
+                }
+            }
+            lost = std::vector<uint8_t>(workers.size(), 0);
+            if (workers.empty())
+            {
+                std::cout << "No workers left, playing every trial here" << std::endl;
+            }
+            splitTrials();
+        }
+    }
+};
+
+struct EsWorker
+{
+    SocketConnection connection;
+
+    // Connects and overwrites params with the coordinator's starting weights, throws if either fails
+    EsWorker(const std::string &host, int port, const EsHelloMessage &hello, Matrix &params)
+        : connection(SocketConnection::connect(host, port))
+    {
+        connection.send(hello);
+        if (!connection.receive<uint32_t>())
+        {
+            throw std::runtime_error("Error: Coordinator refused this worker, it was built with different settings");
+        }
+        connection.receiveAll(params.values, (size_t)params.numValues * sizeof(float));
+    }
+
+    // False once the coordinator has gone
+    bool receiveStep(EsStepMessage &step)
+    {
+        try
+        {
+            step = connection.receive<EsStepMessage>();
+            return true;
+        }
+        catch (const std::runtime_error &)
+        {
+            return false;
+        }
+    }
+
+    // Sends this worker's scores and fills in everyone's, false once the coordinator has gone
+    bool exchangeScores(const EsStepMessage &step, const Matrix &params, float *scores, int nTrials)
+    {
+        try
+        {
+            EsResultMessage result;
+            result.stepNum = step.stepNum;
+            result.paramsCrc = getParamsCrc(params);
+            connection.send(result);
+            connection.sendAll(&scores[step.trialBegin], (size_t)(step.trialEnd - step.trialBegin) * sizeof(float));
+            connection.receiveAll(scores, (size_t)nTrials * sizeof(float));
+            return true;
+        }
+        catch (const std::runtime_error &)
+        {
+            return false;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef FIXED_GAME_HPP
+#define FIXED_GAME_HPP
+
+#include <array>
+#include <cstdint>
+
+#include "game.hpp"
+
+/*
+Compile-time sized snake game for boards up to 8x8.
+
+Plays exactly like SnakeGame (same board encoding, same RNG stream), but:
+- occupancy is a uint64_t bitboard (bit i set where the snake is)
+- moves and wall checks come from constexpr neighbor tables instead of % and bounds checks
+- the body ring buffer and board view are fixed-size arrays, so the whole game lives on the stack
+*/
+
+template <int N>
+struct FixedSnakeGame
+{
+    static_assert(N >= 2 && N <= 8, "FixedSnakeGame needs the board to fit in a uint64_t bitboard");
+
+    static constexpr int size = N;
+    static constexpr int numCells = N * N;
+    static constexpr int bodyCapacity = 64; // Power of two >= numCells so the ring buffer can wrap with a mask
+    static constexpr int bodyMask = bodyCapacity - 1;
+
+    struct NeighborTable
+    {
+        int8_t cells[4][numCells]; // cells[direction][position] = position moved to, or -1 for a wall
+    };
+
+    static constexpr NeighborTable makeNeighborTable()
+    {
+        NeighborTable table = {};
+        for (int position = 0; position < numCells; position++)
+        {
+            const int row = position / N;
+            const int col = position % N;
+            table.cells[SnakeDirections::LEFT][position] = col > 0 ? position - 1 : -1;
+            table.cells[SnakeDirections::UP][position] = row > 0 ? position - N : -1;
+            table.cells[SnakeDirections::RIGHT][position] = col < N - 1 ? position + 1 : -1;
+            table.cells[SnakeDirections::DOWN][position] = row < N - 1 ? position + N : -1;
+        }
+        return table;
+    }
+
+    static constexpr NeighborTable neighbors = makeNeighborTable();
+
+    uint64_t occupied = 0;
+    uint8_t body[bodyCapacity]; // Tail at body[bodyStart], head at body[(bodyStart + bodyLength - 1) & bodyMask]
+    int bodyStart = 0;
+    int bodyLength = 0;
+    uint8_t freeCells[numCells]; // Same free cell set as SnakeGame, so apples land in the same places
+    uint8_t freeIndex[numCells];
+    int numFree = 0;
+    uint8_t boardView[numCells]; // Same encoding as SnakeGame::getBoard()
+    bool boardViewDirty = true;
+    int applePosition = 0;
+
+    int snakeHeadPosition;
+    int snakeDirection = SnakeDirections::RIGHT;
+    int score = 0;
+    uint64_t hash = 0; // Same Zobrist hash as SnakeGame
+
+    FixedSnakeGame(uint32_t &randSeed)
+    {
+        reset(randSeed);
+    }
+
+    // Same signature as SnakeGame so either can be used in templated code
+    FixedSnakeGame(int _size, uint32_t &randSeed)
+        : FixedSnakeGame(randSeed)
+    {
+        (void)_size;
+    }
+
+    void reset(uint32_t &randSeed)
+    {
+        // Reset snake
+        occupied = 0;
+        hash = zobristDirectionKey(SnakeDirections::RIGHT) ^ zobristAppleKey(applePosition);
+        for (int i = 0; i < numCells; i++)
+        {
+            freeCells[i] = i;
+            freeIndex[i] = i;
+        }
+        numFree = numCells;
+        snakeHeadPosition = (N / 2) * N + N / 2;
+        bodyStart = 0;
+        bodyLength = 0;
+        pushHead(snakeHeadPosition - 1);
+        pushHead(snakeHeadPosition);
+        snakeDirection = SnakeDirections::RIGHT;
+
+        // Reset score
+        score = 0;
+
+        // Reset apple position
+        randomizeApplePosition(randSeed);
+    }
+
+    bool isOccupied(int position) const
+    {
+        return (occupied >> position) & 1;
+    }
+
+    void randomizeApplePosition(uint32_t &randSeed)
+    {
+        hash ^= zobristAppleKey(applePosition);
+#ifdef SNAKE_LEGACY_APPLE_PLACEMENT
+        applePosition = randInt(randSeed, numCells);
+        while (isOccupied(applePosition))
+        {
+            applePosition = randInt(randSeed, numCells);
+        }
+#else
+        applePosition = freeCells[randInt(randSeed, numFree)];
+#endif
+        hash ^= zobristAppleKey(applePosition);
+    }
+
+    void removeFree(int position)
+    {
+        const int index = freeIndex[position];
+        const int last = freeCells[numFree - 1];
+        freeCells[index] = last;
+        freeIndex[last] = index;
+        numFree--;
+    }
+
+    void addFree(int position)
+    {
+        freeCells[numFree] = position;
+        freeIndex[position] = numFree;
+        numFree++;
+    }
+
+    void pushHead(int position)
+    {
+        if (bodyLength > 0)
+        {
+            const int oldHead = body[(bodyStart + bodyLength - 1) & bodyMask];
+            hash ^= zobristHeadKey(oldHead) ^ zobristLinkKey(oldHead, zobristLinkDirection(oldHead, position, N));
+        }
+        hash ^= zobristHeadKey(position);
+        body[(bodyStart + bodyLength) & bodyMask] = position;
+        occupied |= (uint64_t)1 << position;
+        removeFree(position);
+        bodyLength++;
+        boardViewDirty = true;
+    }
+
+    void popTail()
+    {
+        const int tail = body[bodyStart];
+        if (bodyLength > 1)
+        {
+            hash ^= zobristLinkKey(tail, zobristLinkDirection(tail, body[(bodyStart + 1) & bodyMask], N));
+        }
+        else
+        {
+            hash ^= zobristHeadKey(tail);
+        }
+        occupied &= ~((uint64_t)1 << body[bodyStart]);
+        addFree(body[bodyStart]);
+        bodyStart = (bodyStart + 1) & bodyMask;
+        bodyLength--;
+        boardViewDirty = true;
+    }
+
+    int getTailPosition() const
+    {
+        return body[bodyStart];
+    }
+
+    const uint8_t *getBoard()
+    {
+        if (boardViewDirty)
+        {
+            for (int i = 0; i < numCells; i++)
+            {
+                boardView[i] = 0;
+            }
+            for (int i = 0; i < bodyLength; i++)
+            {
+                boardView[body[(bodyStart + i) & bodyMask]] = i + 1;
+            }
+            boardViewDirty = false;
+        }
+        return boardView;
+    }
+
+    bool step(SnakeActions action, uint32_t &randSeed)
+    {
+        // Update direction
+        const int oldDirection = snakeDirection;
+        if (action == SnakeActions::TURN_LEFT)
+        {
+            snakeDirection = (snakeDirection + 3) & 3;
+        }
+        else if (action == SnakeActions::TURN_RIGHT)
+        {
+            snakeDirection = (snakeDirection + 1) & 3;
+        }
+        hash ^= zobristDirectionKey(oldDirection) ^ zobristDirectionKey(snakeDirection);
+
+        // Move snake
+        const int newHeadPosition = neighbors.cells[snakeDirection][snakeHeadPosition];
+        if (newHeadPosition < 0)
+        {
+            return true;
+        }
+
+        // Check for snake collisions, the tail will be moved out of the way so it is not a collision
+        if (isOccupied(newHeadPosition) && newHeadPosition != getTailPosition())
+        {
+            return true;
+        }
+
+        // Update head position
+        snakeHeadPosition = newHeadPosition;
+
+        // Apple collision
+        if (snakeHeadPosition == applePosition)
+        {
+            // Increase score
+            score++;
+
+            // Got max score
+            if (score + 2 == numCells)
+            {
+                return true;
+            }
+
+            // Grow snake with new head pos
+            pushHead(snakeHeadPosition);
+            randomizeApplePosition(randSeed);
+        }
+        else
+        {
+            // Move snake, Remove back of snake
+            popTail();
+            pushHead(snakeHeadPosition);
+        }
+
+        return false;
+    }
+
+    void copyState(const FixedSnakeGame &other)
+    {
+        *this = other;
+    }
+
+    void copyState(const SnakeGame &other)
+    {
+        occupied = 0;
+        bodyStart = 0;
+        bodyLength = other.bodyLength;
+        int index = other.bodyStart;
+        for (int i = 0; i < other.bodyLength; i++)
+        {
+            body[i] = other.body[index];
+            occupied |= (uint64_t)1 << other.body[index];
+            index++;
+            if (index == numCells)
+            {
+                index = 0;
+            }
+        }
+        for (int i = 0; i < numCells; i++)
+        {
+            freeCells[i] = other.freeCells[i];
+            freeIndex[i] = other.freeIndex[i];
+        }
+        numFree = other.numFree;
+        boardViewDirty = true;
+        applePosition = other.applePosition;
+        snakeHeadPosition = other.snakeHeadPosition;
+        snakeDirection = other.snakeDirection;
+        score = other.score;
+        hash = other.hash;
+    }
+
+    void print()
+    {
+        const uint8_t *board = getBoard();
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                const int index = i * N + j;
+                if (index == applePosition)
+                {
+                    std::cout << "A" << " ";
+                }
+                else
+                {
+                    std::cout << std::to_string(board[index]) << " ";
+                }
+            }
+            std::cout << std::endl;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef FIXED_MODEL_HPP
+#define FIXED_MODEL_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "neuralNet.hpp"
+
+/*
+Compile-time sized SnakeModel.
+
+Same network, weights and model.bin format as SnakeModel, but every dimension is a template
+argument and the weights live inline in the object instead of in pool buffers.
+
+forward builds board @ weight0 with simdAddScaled like SnakeModel, then runs the activation and the
+output projection as one simdForwardHidden call, so the activations stay in registers and are never
+stored. Its outputs are exactly SnakeModel::forward's at every SIMD level. Constant-size loops left to
+the compiler's vectorizer lost to the hand-written kernels at SSE2 and AVX2 from hidden size 256 up,
+so the template sizes only fix the storage and the loop bounds around the kernel calls.
+
+The weights are inline, so large sizes (2 * Size * Size * Hidden floats) belong on the heap, not the
+stack. SnakeModel stays for code that only learns the sizes at runtime, like test.cpp reading a file.
+*/
+
+template <int Rows, int Cols>
+struct FixedMatrix
+{
+    static constexpr int rows = Rows;
+    static constexpr int cols = Cols;
+    static constexpr int numValues = Rows * Cols;
+
+    alignas(64) float values[numValues] = {};
+
+    void copy(const Matrix &other)
+    {
+        for (int i = 0; i < numValues; i++)
+        {
+            values[i] = other.values[i];
+        }
+    }
+
+    void copyTo(Matrix &other) const
+    {
+        for (int i = 0; i < numValues; i++)
+        {
+            other.values[i] = values[i];
+        }
+    }
+
+    void addRand(uint32_t &randSeed, const float std)
+    {
+        for (int i = 0; i < numValues; i++)
+        {
+            values[i] += randDist(0.0f, std, randSeed);
+        }
+    }
+
+    void setRand(uint32_t &randSeed, const float std)
+    {
+        for (int i = 0; i < numValues; i++)
+        {
+            values[i] = randDist(0.0f, std, randSeed);
+        }
+    }
+};
+
+template <int Size, int Hidden>
+struct FixedSnakeModel
+{
+    static constexpr int size = Size;
+    static constexpr int hiddenSize = Hidden;
+    static constexpr int numCells = Size * Size;
+    static constexpr int numParams = 2 * numCells * Hidden + Hidden * 3;
+
+    FixedMatrix<numCells, Hidden> weight0;
+    FixedMatrix<numCells, Hidden> weight1;
+    FixedMatrix<Hidden, 3> weight2;
+
+    FixedMatrix<1, Hidden> hidden; // board @ weight0, the activation is never stored
+
+    int getNumParams() const
+    {
+        return numParams;
+    }
+
+    // Copy the weights of a runtime model of the same size
+    void copyWeights(const SnakeModel &other)
+    {
+        if (other.size != Size || other.hiddenSize != Hidden)
+        {
+            throw std::runtime_error("Error: FixedSnakeModel size does not match the SnakeModel being copied");
+        }
+        weight0.copy(other.weight0);
+        weight1.copy(other.weight1);
+        weight2.copy(other.weight2);
+    }
+
+    void copyWeightsTo(SnakeModel &other) const
+    {
+        if (other.size != Size || other.hiddenSize != Hidden)
+        {
+            throw std::runtime_error("Error: SnakeModel size does not match the FixedSnakeModel being copied");
+        }
+        weight0.copyTo(other.weight0);
+        weight1.copyTo(other.weight1);
+        weight2.copyTo(other.weight2);
+    }
+
+    // Same draws in the same order as SnakeModel, so a seed gives the same weights in both
+    void addRand(uint32_t &randSeed, const float std)
+    {
+        weight0.addRand(randSeed, std);
+        weight1.addRand(randSeed, std);
+        weight2.addRand(randSeed, std);
+    }
+
+    void setRand(uint32_t &randSeed, const float std)
+    {
+        weight0.setRand(randSeed, std);
+        weight1.setRand(randSeed, std);
+        weight2.setRand(randSeed, std);
+    }
+
+    // Same file format as SnakeModel::saveToFile
+    bool saveToFile(const std::string &filename) const
+    {
+        SnakeModel model = SnakeModel(Size, Hidden);
+        copyWeightsTo(model);
+        return model.saveToFile(filename);
+    }
+
+    // Reads a file of either version written by SnakeModel::saveToFile or saveToFile, it must be for this size
+    void loadFromFile(const std::string &filename)
+    {
+        const SnakeModel model = SnakeModel::mapFromFile(filename);
+        if (model.size != Size || model.hiddenSize != Hidden)
+        {
+            throw std::runtime_error("Error: Model in " + filename + " is " + std::to_string(model.size) + "x" + std::to_string(model.size) +
+                                     " with hidden size " + std::to_string(model.hiddenSize) + ", expected " + std::to_string(Size) + "x" +
+                                     std::to_string(Size) + " with hidden size " + std::to_string(Hidden));
+        }
+        copyWeights(model);
+    }
+
+    void forward(const uint8_t *board, const int applePos, Matrix &out)
+    {
+        // hidden = board @ weight0, a whole row per snake cell streams better than the kernel's per-block cell loop for one board.
+        // A plain loop would be inlined as baseline 16-byte stores that the wider loads after it cannot forward from
+        simdFill(hidden.values, 0.0f, Hidden);
+        for (int i = 0; i < numCells; i++)
+        {
+            // Empty cells add nothing
+            if (board[i] != 0)
+            {
+                simdAddScaled(hidden.values, &weight0.values[i * Hidden], (float)board[i], Hidden);
+            }
+        }
+        forwardHidden(hidden.values, applePos, out);
+    }
+
+    // Same as forward, with board @ weight0 read straight from an accumulator the game loop keeps up to date
+    void forward(const HiddenAccumulator &accumulator, const int applePos, Matrix &out)
+    {
+        forwardHidden(accumulator.preActivation.values, applePos, out);
+    }
+
+    // Rest of the forward pass from board @ weight0, activation and output projection fused in one kernel call
+    void forwardHidden(const float *preActivation, const int applePos, Matrix &out)
+    {
+        simdForwardHidden(preActivation, &weight1.values[applePos * Hidden], weight2.values, Hidden, out.values);
+    }
+};
+
+#endif
@@ -1,10 +1,13 @@
 #ifndef GAME_HPP
+#define GAME_HPP
 
 #include <SFML/Graphics.hpp>
 
 #include <iostream>
+#include <vector>
 
 #include "neuralNet.hpp"
+#include "zobrist.hpp"
 
 enum SnakeDirections
 {
@@ -43,26 +46,143 @@ SnakeActions sampleAction(Matrix &out, uint32_t &randSeed)
     return SnakeActions::NO_TURN;
 };
 
+// Same distribution as sampleAction from the same random number, without the softmax and with exp from the vector kernels' polynomial, out is left as is
+SnakeActions sampleActionFast(const Matrix &out, uint32_t &randSeed)
+{
+    return (SnakeActions)simdSampleAction(out.values, randSeed);
+}
+
+// sampleActionFast for numGames games at once, game i reads row i of logits and steps randSeeds[i]; games with active[i] == 0 are skipped
+void sampleActions(const Matrix &logits, uint32_t *randSeeds, const uint8_t *active, int numGames, int32_t *actions)
+{
+    simdSampleActions(logits.values, randSeeds, active, numGames, actions);
+}
+
 struct SnakeGame
 {
-    uint8_t *board;
-    int applePosition;
+    uint8_t *boardView; // Body encoding read by SnakeModel::forward (tail = 1 ... head = length, empty = 0). Rebuilt lazily by getBoard()
+    bool boardViewDirty = true;
+    uint8_t *occupied; // 1 where the snake is, 0 elsewhere
+    int *body;         // Circular buffer of body cells, tail at body[bodyStart], head at body[bodyStart + bodyLength - 1]
+    int bodyStart = 0;
+    int bodyLength = 0;
+    int *freeCells; // Cells not covered by the snake, in no particular order, freeCells[0 ... numFree - 1]
+    int *freeIndex; // freeIndex[cell] = index of cell in freeCells while the cell is free
+    int numFree = 0;
+    int applePosition = 0;
 
     int size;
     int snakeHeadPosition;
     int snakeDirection = SnakeDirections::RIGHT;
     int score = 0;
+    uint64_t hash = 0; // Zobrist hash of the position, see zobrist.hpp
+
+    // One entry per journaled step, holding what rewind() needs to undo it
+    struct StepRecord
+    {
+        int snakeDirection;
+        int snakeHeadPosition;
+        int applePosition;
+        int score;
+        int tailPosition; // Cell the tail left, -1 if the tail did not move
+        int headFreeSlot; // Index in freeCells the new head was taken from, -1 if no head was added
+        uint64_t hash;
+    };
+    std::vector<StepRecord> journal;
+    bool journalEnabled = false;
 
     SnakeGame(int _size, uint32_t &randSeed)
     {
         size = _size;
-        board = new uint8_t[size * size];
+        acquireBuffers();
         reset(randSeed);
     }
 
+    SnakeGame(const SnakeGame &other)
+    {
+        size = other.size;
+        acquireBuffers();
+        copyState(other);
+    }
+
+    SnakeGame(SnakeGame &&other) noexcept
+    {
+        // Every field swap() hands over without a default, so the moved-from game is left empty rather than uninitialized
+        size = 0;
+        snakeHeadPosition = 0;
+        boardView = nullptr;
+        occupied = nullptr;
+        body = nullptr;
+        freeCells = nullptr;
+        freeIndex = nullptr;
+        swap(other);
+    }
+
+    SnakeGame &operator=(const SnakeGame &other)
+    {
+        if (this != &other)
+        {
+            if (size != other.size)
+            {
+                releaseBuffers();
+                size = other.size;
+                acquireBuffers();
+            }
+            copyState(other);
+        }
+        return *this;
+    }
+
+    SnakeGame &operator=(SnakeGame &&other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
     ~SnakeGame()
     {
-        delete[] board;
+        releaseBuffers();
+    }
+
+    // Buffers come from the pool, so games can be created and destroyed in a loop without touching the heap
+    void acquireBuffers()
+    {
+        boardView = poolAcquire<uint8_t>(size * size);
+        occupied = poolAcquire<uint8_t>(size * size);
+        body = poolAcquire<int>(size * size);
+        freeCells = poolAcquire<int>(size * size);
+        freeIndex = poolAcquire<int>(size * size);
+        boardViewDirty = true;
+    }
+
+    void releaseBuffers()
+    {
+        poolRelease(boardView, size * size);
+        poolRelease(occupied, size * size);
+        poolRelease(body, size * size);
+        poolRelease(freeCells, size * size);
+        poolRelease(freeIndex, size * size);
+    }
+
+    void swap(SnakeGame &other) noexcept
+    {
+        std::swap(boardView, other.boardView);
+        std::swap(boardViewDirty, other.boardViewDirty);
+        std::swap(occupied, other.occupied);
+        std::swap(body, other.body);
+        std::swap(bodyStart, other.bodyStart);
+        std::swap(bodyLength, other.bodyLength);
+        std::swap(freeCells, other.freeCells);
+        std::swap(freeIndex, other.freeIndex);
+        std::swap(numFree, other.numFree);
+        std::swap(applePosition, other.applePosition);
+        std::swap(size, other.size);
+        std::swap(snakeHeadPosition, other.snakeHeadPosition);
+        std::swap(snakeDirection, other.snakeDirection);
+        std::swap(score, other.score);
+        std::swap(hash, other.hash);
+        std::swap(journal, other.journal);
+        std::swap(journalEnabled, other.journalEnabled);
     }
 
     void reset(uint32_t &randSeed)
@@ -70,13 +190,20 @@ struct SnakeGame
         // Reset board
         for (int i = 0; i < size * size; i++)
         {
-            board[i] = false;
+            occupied[i] = false;
+            freeCells[i] = i;
+            freeIndex[i] = i;
         }
+        numFree = size * size;
 
         // Reset snake
+        journal.clear();
+        hash = zobristDirectionKey(SnakeDirections::RIGHT) ^ zobristAppleKey(applePosition);
         snakeHeadPosition = (size / 2) * size + size / 2;
-        board[snakeHeadPosition] = 2;
-        board[snakeHeadPosition - 1] = 1;
+        bodyStart = 0;
+        bodyLength = 0;
+        pushHead(snakeHeadPosition - 1);
+        pushHead(snakeHeadPosition);
         snakeDirection = SnakeDirections::RIGHT;
 
         // Reset score
@@ -88,15 +215,122 @@ struct SnakeGame
 
     void randomizeApplePosition(uint32_t &randSeed)
     {
+        hash ^= zobristAppleKey(applePosition);
+#ifdef SNAKE_LEGACY_APPLE_PLACEMENT
+        // Rejection sampling, reproduces the RNG stream of older builds
         applePosition = randInt(randSeed, size * size);
-        while (board[applePosition] > 0)
+        while (occupied[applePosition] > 0)
         {
             applePosition = randInt(randSeed, size * size);
         }
+#else
+        // One draw from the free cells, uniform at any fill level
+        applePosition = freeCells[randInt(randSeed, numFree)];
+#endif
+        hash ^= zobristAppleKey(applePosition);
+    }
+
+    // Remove a cell from the free set by moving the last free cell into its slot
+    void removeFree(int position)
+    {
+        const int index = freeIndex[position];
+        const int last = freeCells[numFree - 1];
+        freeCells[index] = last;
+        freeIndex[last] = index;
+        numFree--;
+    }
+
+    void addFree(int position)
+    {
+        freeCells[numFree] = position;
+        freeIndex[position] = numFree;
+        numFree++;
+    }
+
+    // Add a new head cell to the front of the body
+    void pushHead(int position)
+    {
+        int index = bodyStart + bodyLength;
+        if (index >= size * size)
+        {
+            index -= size * size;
+        }
+        if (bodyLength > 0)
+        {
+            // The old head becomes a link pointing at the new one
+            const int oldHead = body[index == 0 ? size * size - 1 : index - 1];
+            hash ^= zobristHeadKey(oldHead) ^ zobristLinkKey(oldHead, zobristLinkDirection(oldHead, position, size));
+        }
+        hash ^= zobristHeadKey(position);
+        body[index] = position;
+        occupied[position] = 1;
+        removeFree(position);
+        bodyLength++;
+        boardViewDirty = true;
+    }
+
+    // Remove the tail cell from the back of the body
+    void popTail()
+    {
+        const int tail = body[bodyStart];
+        if (bodyLength > 1)
+        {
+            const int next = body[bodyStart + 1 == size * size ? 0 : bodyStart + 1];
+            hash ^= zobristLinkKey(tail, zobristLinkDirection(tail, next, size));
+        }
+        else
+        {
+            hash ^= zobristHeadKey(tail);
+        }
+        occupied[body[bodyStart]] = 0;
+        addFree(body[bodyStart]);
+        bodyStart++;
+        if (bodyStart == size * size)
+        {
+            bodyStart = 0;
+        }
+        bodyLength--;
+        boardViewDirty = true;
+    }
+
+    int getTailPosition() const
+    {
+        return body[bodyStart];
+    }
+
+    // Get the board encoding that SnakeModel::forward expects, rebuilding it from the body buffer if the snake moved since the last call
+    const uint8_t *getBoard()
+    {
+        if (boardViewDirty)
+        {
+            for (int i = 0; i < size * size; i++)
+            {
+                boardView[i] = 0;
+            }
+            int index = bodyStart;
+            for (int i = 0; i < bodyLength; i++)
+            {
+                boardView[body[index]] = i + 1;
+                index++;
+                if (index == size * size)
+                {
+                    index = 0;
+                }
+            }
+            boardViewDirty = false;
+        }
+        return boardView;
     }
 
     bool step(SnakeActions action, uint32_t &randSeed)
     {
+        // Record the state this step overwrites
+        if (journalEnabled)
+        {
+            journal.push_back({snakeDirection, snakeHeadPosition, applePosition, score, -1, -1, hash});
+        }
+        const int oldDirection = snakeDirection;
+
         // Update direction
         if (action == SnakeActions::TURN_LEFT)
         {
@@ -106,14 +340,15 @@ struct SnakeGame
         {
             snakeDirection = (snakeDirection + 4 + 1) % 4;
         }
+        hash ^= zobristDirectionKey(oldDirection) ^ zobristDirectionKey(snakeDirection);
 
         // Move snake
-        int newHeadPosition;
+        int newHeadPosition = snakeHeadPosition;
         bool hitSomething = false;
         if (snakeDirection == SnakeDirections::LEFT)
         {
             newHeadPosition = snakeHeadPosition - 1;
-            hitSomething = (newHeadPosition % size == size - 1);
+            hitSomething = (snakeHeadPosition % size == 0); // Checked on the old head so that position 0 does not wrap to -1
         }
         else if (snakeDirection == SnakeDirections::UP)
         {
@@ -137,7 +372,7 @@ struct SnakeGame
         }
 
         // Check for snake collisions
-        if (board[newHeadPosition] > 1) // Greater than 1 because we have not updated the tail yet, so the tail (value == 1) will be moved when we move the head to this position
+        if (occupied[newHeadPosition] && newHeadPosition != getTailPosition()) // The tail will be moved out of the way when we move the head, so it is not a collision
         {
             return true;
         }
@@ -157,44 +392,144 @@ struct SnakeGame
                 return true;
             }
 
-            // Update board with new head pos
-            board[snakeHeadPosition] = score + 2; // +2 because we start with a length of 2
+            // Grow snake with new head pos
+            if (journalEnabled)
+            {
+                journal.back().headFreeSlot = freeIndex[snakeHeadPosition];
+            }
+            pushHead(snakeHeadPosition);
             randomizeApplePosition(randSeed);
         }
         else
         {
             // Move snake, Remove back of snake
-            uint8_t *boardptr = board;
-            uint8_t *end = boardptr + (size * size - 1);
-            for (; boardptr <= end; boardptr++)
+            if (journalEnabled)
             {
-                if (*boardptr > 0)
-                {
-                    (*boardptr)--;
-                }
+                journal.back().tailPosition = getTailPosition();
             }
-
-            // Update board with new head pos
-            board[snakeHeadPosition] = score + 2; // +2 because we start with a length of 2
+            popTail();
+            if (journalEnabled)
+            {
+                journal.back().headFreeSlot = freeIndex[snakeHeadPosition];
+            }
+            pushHead(snakeHeadPosition);
         }
 
         return false;
     }
 
+    // Start journaling steps and return a mark that rewind() can return to. Rewinding costs O(1) per step taken since the mark, instead of copyState's O(size * size)
+    int checkpoint()
+    {
+        journalEnabled = true;
+        return (int)journal.size();
+    }
+
+    void rewind(int mark)
+    {
+        while ((int)journal.size() > mark)
+        {
+            undoStep(journal.back());
+            journal.pop_back();
+        }
+    }
+
+    // Stop journaling and forget all marks
+    void clearJournal()
+    {
+        journal.clear();
+        journalEnabled = false;
+    }
+
+    // Undo pushHead and popTail in the reverse order step() did them
+    void undoStep(const StepRecord &record)
+    {
+        if (record.headFreeSlot >= 0)
+        {
+            // Put the head back in its free slot and the cell that was swapped into that slot back at the end
+            const int head = snakeHeadPosition;
+            const int moved = freeCells[record.headFreeSlot];
+            freeCells[numFree] = moved;
+            freeIndex[moved] = numFree;
+            freeCells[record.headFreeSlot] = head;
+            freeIndex[head] = record.headFreeSlot;
+            numFree++;
+            occupied[head] = 0;
+            bodyLength--;
+        }
+
+        if (record.tailPosition >= 0)
+        {
+            // The tail was the last cell added to the free set
+            numFree--;
+            occupied[record.tailPosition] = 1;
+            bodyStart = bodyStart == 0 ? size * size - 1 : bodyStart - 1;
+            body[bodyStart] = record.tailPosition;
+            bodyLength++;
+        }
+
+        snakeDirection = record.snakeDirection;
+        snakeHeadPosition = record.snakeHeadPosition;
+        applePosition = record.applePosition;
+        score = record.score;
+        hash = record.hash;
+        boardViewDirty = true;
+    }
+
     void copyState(const SnakeGame &other)
     {
         for (int i = 0; i < size * size; i++)
         {
-            board[i] = other.board[i];
+            occupied[i] = other.occupied[i];
+            freeCells[i] = other.freeCells[i];
+            freeIndex[i] = other.freeIndex[i];
         }
+        numFree = other.numFree;
+        int index = other.bodyStart;
+        for (int i = 0; i < other.bodyLength; i++)
+        {
+            body[i] = other.body[index];
+            index++;
+            if (index == size * size)
+            {
+                index = 0;
+            }
+        }
+        bodyStart = 0;
+        bodyLength = other.bodyLength;
+        boardViewDirty = true;
         applePosition = other.applePosition;
         snakeHeadPosition = other.snakeHeadPosition;
         snakeDirection = other.snakeDirection;
         score = other.score;
+        hash = other.hash;
+        clearJournal();
+    }
+
+    // Hash of the position rebuilt from scratch, matches the incrementally updated hash
+    uint64_t computeHash() const
+    {
+        uint64_t fullHash = zobristDirectionKey(snakeDirection) ^ zobristAppleKey(applePosition);
+        int index = bodyStart;
+        for (int i = 0; i < bodyLength; i++)
+        {
+            const int next = index + 1 == size * size ? 0 : index + 1;
+            if (i == bodyLength - 1)
+            {
+                fullHash ^= zobristHeadKey(body[index]);
+            }
+            else
+            {
+                fullHash ^= zobristLinkKey(body[index], zobristLinkDirection(body[index], body[next], size));
+            }
+            index = next;
+        }
+        return fullHash;
     }
 
     void print()
     {
+        const uint8_t *board = getBoard();
         for (int i = 0; i < size; i++)
         {
             for (int j = 0; j < size; j++)
@@ -218,6 +553,7 @@ struct SnakeGame
         const float cellSize = std::min((float)window.getSize().x / (float)size, (float)window.getSize().y / (float)size);
         const float offsetX = (window.getSize().x - cellSize * size) / 2;
         const float offsetY = (window.getSize().y - cellSize * size) / 2;
+        const uint8_t *board = getBoard();
 
         // Clear the window
         window.clear(sf::Color::Black);
@@ -5,75 +5,168 @@
 #include <iomanip>
 
 #include "game.hpp"
+#include "fixedGame.hpp"
+#include "threadPool.hpp"
+#include "mcts.hpp"
+#include "policyTable.hpp"
 
-std::vector<float> getScores(const SnakeGame &game, uint32_t &randSeed, const int iters)
+// Take action, then play random actions until the game ends or size * size steps pass
+template <typename Game>
+int playRollout(Game &game, SnakeActions action, uint32_t &randSeed)
 {
-    // Counters for scores gotten
-    int turnLeftScore = 0;
-    int turnRightScore = 0;
-    int noTurnScore = 0;
-
-    // Copy of game for test runs
-    SnakeGame newGame = SnakeGame(game.size, randSeed);
-
-    for (int i = 0; i < iters; i++)
+    bool gameOver = game.step(action, randSeed);
+    if (!gameOver)
     {
-        // Play left turn
-        newGame.copyState(game);
-        bool gameOver = newGame.step(SnakeActions::TURN_LEFT, randSeed);
-        if (!gameOver)
+        for (int j = 0; j < game.size * game.size; j++)
         {
-            for (int j = 0; j < game.size * game.size; j++)
+            gameOver = game.step(randAction(randSeed), randSeed);
+            if (gameOver)
             {
-                gameOver = newGame.step(randAction(randSeed), randSeed);
-                if (gameOver)
-                {
-                    break;
-                }
+                break;
             }
         }
-        turnLeftScore = std::max(turnLeftScore, newGame.score);
+    }
+    return game.score;
+}
 
-        // Play right turn
-        newGame.copyState(game);
-        gameOver = newGame.step(SnakeActions::TURN_RIGHT, randSeed);
-        if (!gameOver)
+// Per action results of a batch of rollouts
+struct RolloutStats
+{
+    int maxScores[3] = {0, 0, 0};
+    float totalScores[3] = {0.0f, 0.0f, 0.0f};
+    int numRollouts = 0;
+
+    void merge(const RolloutStats &other)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            maxScores[i] = std::max(maxScores[i], other.maxScores[i]);
+            totalScores[i] += other.totalScores[i];
+        }
+        numRollouts += other.numRollouts;
+    }
+
+    float getMeanScore(int action) const
+    {
+        return numRollouts > 0 ? totalScores[action] / (float)numRollouts : 0.0f;
+    }
+
+    // Best max score, ties broken by mean score, then NO_TURN
+    SnakeActions getBestAction() const
+    {
+        auto isBetter = [&](int a, int b)
+        {
+            return maxScores[a] > maxScores[b] || (maxScores[a] == maxScores[b] && getMeanScore(a) > getMeanScore(b));
+        };
+        if (isBetter(SnakeActions::TURN_LEFT, SnakeActions::TURN_RIGHT) && isBetter(SnakeActions::TURN_LEFT, SnakeActions::NO_TURN))
         {
-            for (int j = 0; j < game.size * game.size; j++)
+            return SnakeActions::TURN_LEFT;
+        }
+        if (isBetter(SnakeActions::TURN_RIGHT, SnakeActions::TURN_LEFT) && isBetter(SnakeActions::TURN_RIGHT, SnakeActions::NO_TURN))
+        {
+            return SnakeActions::TURN_RIGHT;
+        }
+        return SnakeActions::NO_TURN;
+    }
+};
+
+template <int N>
+RolloutStats runRollouts(const SnakeGame &game, uint32_t &randSeed, const int iters)
+{
+    // Counters for scores gotten, kept local so workers do not share cache lines while playing
+    RolloutStats stats;
+    const SnakeActions actions[3] = {SnakeActions::TURN_LEFT, SnakeActions::TURN_RIGHT, SnakeActions::NO_TURN};
+
+    if constexpr (N <= 8)
+    {
+        // Copy of game for test runs, small enough that restoring it is a flat struct copy
+        FixedSnakeGame<N> newGame = FixedSnakeGame<N>(randSeed);
+        FixedSnakeGame<N> rootGame = newGame;
+        rootGame.copyState(game);
+
+        for (int i = 0; i < iters; i++)
+        {
+            for (SnakeActions action : actions)
             {
-                gameOver = newGame.step(randAction(randSeed), randSeed);
-                if (gameOver)
-                {
-                    break;
-                }
+                newGame.copyState(rootGame);
+                const int score = playRollout(newGame, action, randSeed);
+                stats.maxScores[action] = std::max(stats.maxScores[action], score);
+                stats.totalScores[action] += score;
             }
         }
-        turnRightScore = std::max(turnRightScore, newGame.score);
-
-        // Play no turn
+    }
+    else
+    {
+        // Copy of game for test runs, rewound to the root after each rollout instead of copying the whole board
+        SnakeGame newGame = SnakeGame(game.size, randSeed);
         newGame.copyState(game);
-        gameOver = newGame.step(SnakeActions::NO_TURN, randSeed);
-        if (!gameOver)
+        const int root = newGame.checkpoint();
+
+        for (int i = 0; i < iters; i++)
         {
-            for (int j = 0; j < game.size * game.size; j++)
+            for (SnakeActions action : actions)
             {
-                gameOver = newGame.step(randAction(randSeed), randSeed);
-                if (gameOver)
-                {
-                    break;
-                }
+                newGame.rewind(root);
+                const int score = playRollout(newGame, action, randSeed);
+                stats.maxScores[action] = std::max(stats.maxScores[action], score);
+                stats.totalScores[action] += score;
             }
         }
-        noTurnScore = std::max(noTurnScore, newGame.score);
     }
 
-    std::vector<float> scores = {(float)turnLeftScore,
-                                 (float)turnRightScore,
-                                 (float)noTurnScore};
-    return scores;
+    stats.numRollouts = iters;
+    return stats;
 }
 
-int main()
+// Splits the rollouts for a move across a persistent pool of workers, each with its own PCG stream,
+// and runs them in the background so the window keeps handling events while they search
+template <int N>
+struct RolloutSearch
+{
+    ThreadPool pool;
+    SnakeGame rootGame;
+    std::vector<RolloutStats> workerStats;
+
+    RolloutSearch(uint32_t &randSeed, int numThreads = 0)
+        : pool(numThreads),
+          rootGame(N, randSeed),
+          workerStats(pool.numThreads)
+    {
+    }
+
+    void start(const SnakeGame &game, uint32_t &randSeed, const int iters)
+    {
+        pool.wait();
+        rootGame = game;
+        const uint32_t searchSeed = PCG_Hash(randSeed);
+        randSeed = searchSeed;
+
+        pool.start([this, searchSeed, iters](int workerIndex)
+                   {
+                       const int numWorkers = pool.numThreads;
+                       const int workerIters = iters / numWorkers + (workerIndex < iters % numWorkers ? 1 : 0);
+                       uint32_t workerSeed = PCG_Hash(searchSeed ^ PCG_Hash(workerIndex + 1));
+                       workerStats[workerIndex] = runRollouts<N>(rootGame, workerSeed, workerIters); });
+    }
+
+    bool isDone()
+    {
+        return pool.isDone();
+    }
+
+    RolloutStats getStats()
+    {
+        pool.wait();
+        RolloutStats stats;
+        for (const RolloutStats &workerStat : workerStats)
+        {
+            stats.merge(workerStat);
+        }
+        return stats;
+    }
+};
+
+int main(int argc, char **argv)
 {
     // Init window
     sf::RenderWindow window(sf::VideoMode(800, 600), "Snake Bot");
@@ -101,7 +194,59 @@ int main()
 
     int iters = 1000;
     int itersDelta = 500;
-    std::cout << "Searching with " << iters << " iters" << std::endl;
+    RolloutSearch<gameSize> search = RolloutSearch<gameSize>(randSeed);
+    std::cout << "Searching with " << iters << " iters on " << search.pool.numThreads << " threads" << std::endl;
+
+    // MCTS bot, press M to switch between it and the flat rollouts. Pass a training run # to use that model as the MCTS prior
+    using MCTSGame = std::conditional_t<(gameSize <= 8), FixedSnakeGame<gameSize>, SnakeGame>;
+    SnakeModel priorModel = SnakeModel(gameSize, 1);
+    bool hasPriorModel = false;
+    if (argc > 1)
+    {
+        priorModel = SnakeModel::mapFromFile("trainingRuns/" + std::string(argv[1]) + "/model.bin");
+        if (priorModel.size != gameSize)
+        {
+            std::cerr << "Training run " << argv[1] << " has a " << priorModel.size << "x" << priorModel.size << " model, the game is "
+                      << gameSize << "x" << gameSize << std::endl;
+            return -1;
+        }
+        hasPriorModel = true;
+        std::cout << "Using model from training run " << argv[1] << " as the MCTS prior" << std::endl;
+    }
+    uint32_t mctsRandSeed = PCG_Hash(randSeed);
+    MCTS<MCTSGame> mcts = MCTS<MCTSGame>(gameSize, mctsRandSeed, hasPriorModel ? &priorModel : nullptr);
+    TranspositionTable table = TranspositionTable(1 << 20); // Rollout values by position, kept across moves
+    mcts.table = &table;
+    ThreadPool mctsWorker = ThreadPool(1);
+    SnakeGame mctsRootGame = game;
+    SnakeActions mctsAction = SnakeActions::NO_TURN;
+    float mctsBudget = 0.05f; // Seconds of search per move
+    float mctsBudgetDelta = 0.025f;
+    bool useMCTS = false;
+
+    // Solved policy, press P to play it instead of searching. Written by solve.cpp
+    PolicyTable policy;
+    bool usePolicy = false;
+    if (policy.load(getPolicyTablePath(gameSize), gameSize))
+    {
+        std::cout << "Loaded policy table with " << policy.header->numStates << " positions, press P to use it" << std::endl;
+    }
+
+    // Searches run in the background, the loop below only polls them
+    auto startSearch = [&]()
+    {
+        if (useMCTS)
+        {
+            mctsRootGame = game;
+            mctsWorker.start([&, budget = mctsBudget](int)
+                             { mctsAction = mcts.search(mctsRootGame, mctsRandSeed, budget); });
+        }
+        else
+        {
+            search.start(game, randSeed, iters);
+        }
+    };
+    startSearch();
 
     while (window.isOpen())
     {
@@ -114,39 +259,91 @@ int main()
             {
                 if (event.key.code == sf::Keyboard::Equal || event.key.code == sf::Keyboard::Add)
                 {
-                    iters += itersDelta;
-                    std::cout << "Searching with " << iters << " iters" << std::endl;
+                    if (useMCTS)
+                    {
+                        mctsBudget += mctsBudgetDelta;
+                        std::cout << "Searching for " << mctsBudget << " seconds per move" << std::endl;
+                    }
+                    else
+                    {
+                        iters += itersDelta;
+                        std::cout << "Searching with " << iters << " iters" << std::endl;
+                    }
                 }
                 else if (event.key.code == sf::Keyboard::Hyphen || event.key.code == sf::Keyboard::Subtract)
                 {
-                    iters -= itersDelta;
-                    std::cout << "Searching with " << iters << " iters" << std::endl;
+                    if (useMCTS)
+                    {
+                        mctsBudget = std::max(mctsBudgetDelta, mctsBudget - mctsBudgetDelta);
+                        std::cout << "Searching for " << mctsBudget << " seconds per move" << std::endl;
+                    }
+                    else
+                    {
+                        iters -= itersDelta;
+                        std::cout << "Searching with " << iters << " iters" << std::endl;
+                    }
+                }
+                else if (event.key.code == sf::Keyboard::M)
+                {
+                    // Let the running search finish, then restart in the other mode
+                    search.pool.wait();
+                    mctsWorker.wait();
+                    useMCTS = !useMCTS;
+                    mcts.resetTree();
+                    std::cout << (useMCTS ? "Using MCTS" : "Using flat rollouts") << std::endl;
+                    startSearch();
+                }
+                else if (event.key.code == sf::Keyboard::P && policy.isLoaded())
+                {
+                    // Table lookups need no search, so stop searching while the table plays
+                    search.pool.wait();
+                    mctsWorker.wait();
+                    usePolicy = !usePolicy;
+                    mcts.resetTree();
+                    std::cout << (usePolicy ? "Using policy table" : (useMCTS ? "Using MCTS" : "Using flat rollouts")) << std::endl;
+                    if (!usePolicy)
+                    {
+                        startSearch();
+                    }
                 }
             }
         }
 
-        if (gameClock.getElapsedTime().asSeconds() > tickSpeed)
+        // Step once the tick is up and the background search for this position has finished
+        if (gameClock.getElapsedTime().asSeconds() > tickSpeed && (usePolicy || (useMCTS ? mctsWorker.isDone() : search.isDone())))
         {
             // Update game
-            std::vector<float> scores = getScores(game, randSeed, iters);
-            SnakeActions currentAction;
-            if (scores[0] > scores[1] && scores[0] > scores[2])
+            SnakeActions currentAction = SnakeActions::NO_TURN;
+            if (usePolicy)
             {
-                currentAction = SnakeActions::TURN_LEFT;
-            }
-            else if (scores[1] > scores[0] && scores[1] > scores[2])
-            {
-                currentAction = SnakeActions::TURN_RIGHT;
+                if (!policy.getAction(game.hash, currentAction))
+                {
+                    // A position the solver never reached, flat rollouts pick this move instead
+                    std::cout << "Position not in the policy table, searching it" << std::endl;
+                    search.start(game, randSeed, iters);
+                    currentAction = search.getStats().getBestAction();
+                }
             }
             else
             {
-                currentAction = SnakeActions::NO_TURN;
+                currentAction = useMCTS ? mctsAction : search.getStats().getBestAction();
             }
-
             bool gameOver = game.step(currentAction, randSeed);
             if (gameOver)
             {
                 game.reset(randSeed);
+                mcts.resetTree();
+            }
+            else if (useMCTS && !usePolicy)
+            {
+                // Keep the subtree for the move just played
+                mcts.advance(currentAction, game);
+            }
+
+            // Search the next move while this one is shown
+            if (!usePolicy)
+            {
+                startSearch();
             }
 
             gameClock.restart();
@@ -0,0 +1,422 @@
+#ifndef MCTS_HPP
+#define MCTS_HPP
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "game.hpp"
+#include "transpositionTable.hpp"
+
+/*
+Monte-Carlo tree search over a snake game (SnakeGame or FixedSnakeGame<N>).
+
+Decision nodes pick one of the 3 actions with PUCT. An action that eats an apple leads to a chance
+node whose children are the apple spawns seen so far, found by stepping the game and reading where
+the apple landed, so spawns are sampled with their real probabilities. Leaves are valued with a
+rollout. Values are apples eaten from the node on.
+
+search() runs until a deadline and can be called again for the next move after advance(), which
+keeps the subtree of the action taken. If a SnakeModel is given, its softmax is used as the prior
+and optionally as the rollout policy.
+
+If a TranspositionTable is set, every leaf rollout is also added to the table under the leaf's
+Zobrist hash, and the leaf is valued with the table's mean instead of the single rollout. Positions
+reached by different move orders, or in earlier searches, then share their rollouts.
+*/
+
+template <typename Game>
+struct MCTS
+{
+    enum NodeType
+    {
+        DECISION,
+        CHANCE,
+        TERMINAL
+    };
+
+    struct Node
+    {
+        int visits = 0;
+        float totalValue = 0.0f;          // Sum of (reward on the edge into this node + return after it) over visits
+        int children[3] = {-1, -1, -1};   // Decision nodes: child reached by each action
+        float priors[3] = {1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f};
+        int firstOutcome = -1;            // Chance nodes: first child in the list of apple spawns
+        int nextOutcome = -1;             // Children of chance nodes: next spawn of the same chance node
+        int applePosition = -1;           // Children of chance nodes: where the apple spawned
+        uint8_t type = DECISION;
+        bool expanded = false;
+    };
+
+    std::vector<Node> nodes;
+    int root = -1;
+
+    Game scratchGame;
+    Game rootState; // Search root for games restored by copying instead of rewinding
+    SnakeModel *model;
+    Matrix out;
+    HiddenAccumulator accumulator; // Carries board @ weight0 through model rollouts
+    bool useModelRollouts = false;
+    TranspositionTable *table = nullptr;
+
+    float explorationConstant = 1.5f;
+    float valueScale = 1.0f; // Largest return seen, used to bring Q into roughly [0, 1]
+    int rolloutDepth;
+    int maxNodes;
+    int lastIterations = 0;
+
+    // Scratch for one iteration
+    std::vector<int> path;
+    std::vector<float> pathRewards;
+
+    MCTS(int size, uint32_t &randSeed, SnakeModel *_model = nullptr, int _maxNodes = 1 << 20)
+        : scratchGame(size, randSeed),
+          rootState(scratchGame),
+          model(_model),
+          out(1, 3)
+    {
+        if (model != nullptr)
+        {
+            if (model->size != size)
+            {
+                throw std::runtime_error("Error: MCTS prior model is " + std::to_string(model->size) + "x" + std::to_string(model->size) +
+                                         ", the game is " + std::to_string(size) + "x" + std::to_string(size));
+            }
+            accumulator = HiddenAccumulator(model->hiddenSize);
+        }
+        rolloutDepth = size * size;
+        maxNodes = _maxNodes;
+        resetTree();
+    }
+
+    void resetTree()
+    {
+        nodes.clear();
+        root = addNode(DECISION);
+    }
+
+    int addNode(NodeType type)
+    {
+        nodes.push_back(Node());
+        nodes.back().type = type;
+        return (int)nodes.size() - 1;
+    }
+
+    int findOutcome(int chanceNode, int applePosition)
+    {
+        for (int child = nodes[chanceNode].firstOutcome; child >= 0; child = nodes[child].nextOutcome)
+        {
+            if (nodes[child].applePosition == applePosition)
+            {
+                return child;
+            }
+        }
+        return -1;
+    }
+
+    int addOutcome(int chanceNode, int applePosition)
+    {
+        const int child = addNode(DECISION);
+        nodes[child].applePosition = applePosition;
+        nodes[child].nextOutcome = nodes[chanceNode].firstOutcome;
+        nodes[chanceNode].firstOutcome = child;
+        return child;
+    }
+
+    void expand(int node)
+    {
+        nodes[node].expanded = true;
+        if (model != nullptr)
+        {
+            model->forward(scratchGame.getBoard(), scratchGame.applePosition, out);
+            out.softmax();
+            for (int i = 0; i < 3; i++)
+            {
+                nodes[node].priors[i] = out.values[i];
+            }
+        }
+    }
+
+    int selectAction(int node)
+    {
+        const Node &parent = nodes[node];
+        const float sqrtVisits = std::sqrt((float)std::max(1, parent.visits));
+        int bestAction = SnakeActions::NO_TURN;
+        float bestScore = -std::numeric_limits<float>::infinity();
+        for (int action = 0; action < 3; action++)
+        {
+            const int child = parent.children[action];
+            const int childVisits = child >= 0 ? nodes[child].visits : 0;
+            const float q = childVisits > 0 ? nodes[child].totalValue / (float)childVisits / valueScale : 0.0f;
+            const float u = explorationConstant * parent.priors[action] * sqrtVisits / (1.0f + (float)childVisits);
+            if (q + u > bestScore)
+            {
+                bestScore = q + u;
+                bestAction = action;
+            }
+        }
+        return bestAction;
+    }
+
+    // Apples eaten by the rollout policy from the scratch game's current state
+    float rollout(uint32_t &randSeed)
+    {
+        const int startScore = scratchGame.score;
+        const bool modelRollout = model != nullptr && useModelRollouts;
+        if (modelRollout)
+        {
+            accumulator.refresh(model->weight0, scratchGame.getBoard());
+        }
+        for (int i = 0; i < rolloutDepth; i++)
+        {
+            SnakeActions action;
+            const int tailPosition = scratchGame.getTailPosition();
+            const int length = scratchGame.bodyLength;
+            if (modelRollout)
+            {
+                model->forward(accumulator, scratchGame.applePosition, out);
+                action = sampleAction(out, randSeed);
+            }
+            else
+            {
+                action = randAction(randSeed);
+            }
+            if (scratchGame.step(action, randSeed))
+            {
+                break;
+            }
+            if (modelRollout)
+            {
+                accumulator.update(model->weight0, scratchGame, tailPosition, length);
+            }
+        }
+        return (float)(scratchGame.score - startScore);
+    }
+
+    // Value of the scratch game's current state, pooled with earlier rollouts from the same position if there is a table
+    float evaluateLeaf(uint32_t &randSeed)
+    {
+        const uint64_t leafHash = scratchGame.hash;
+        const float value = rollout(randSeed);
+        if (table == nullptr)
+        {
+            return value;
+        }
+
+        table->update(leafHash, value);
+        float meanValue;
+        int visits;
+        return table->probe(leafHash, meanValue, visits) ? meanValue : value;
+    }
+
+    void iterate(uint32_t &randSeed)
+    {
+        path.clear();
+        pathRewards.clear();
+        path.push_back(root);
+        pathRewards.push_back(0.0f);
+
+        int node = root;
+        float leafValue = 0.0f;
+        while (true)
+        {
+            if (nodes[node].type == TERMINAL)
+            {
+                break;
+            }
+
+            if (!nodes[node].expanded)
+            {
+                expand(node);
+                leafValue = evaluateLeaf(randSeed);
+                break;
+            }
+
+            const int action = selectAction(node);
+            const int scoreBefore = scratchGame.score;
+            const bool gameOver = scratchGame.step((SnakeActions)action, randSeed);
+            const bool ateApple = scratchGame.score > scoreBefore;
+            const float reward = ateApple ? 1.0f : 0.0f;
+
+            int child = nodes[node].children[action];
+            if (child < 0)
+            {
+                if ((int)nodes.size() >= maxNodes)
+                {
+                    // Tree is full, value the move with a rollout instead of growing the tree
+                    path.push_back(-1);
+                    pathRewards.push_back(reward);
+                    leafValue = gameOver ? 0.0f : evaluateLeaf(randSeed);
+                    break;
+                }
+                child = addNode(gameOver ? TERMINAL : (ateApple ? CHANCE : DECISION));
+                nodes[node].children[action] = child;
+            }
+            path.push_back(child);
+            pathRewards.push_back(reward);
+            node = child;
+
+            // Resolve the apple spawn
+            if (nodes[node].type == CHANCE)
+            {
+                int outcome = findOutcome(node, scratchGame.applePosition);
+                if (outcome < 0)
+                {
+                    if ((int)nodes.size() >= maxNodes)
+                    {
+                        leafValue = evaluateLeaf(randSeed);
+                        break;
+                    }
+                    outcome = addOutcome(node, scratchGame.applePosition);
+                }
+                path.push_back(outcome);
+                pathRewards.push_back(0.0f);
+                node = outcome;
+            }
+        }
+
+        // Back up returns from the leaf to the root
+        float value = leafValue;
+        for (int i = (int)path.size() - 1; i >= 0; i--)
+        {
+            value += pathRewards[i];
+            if (path[i] >= 0)
+            {
+                nodes[path[i]].visits++;
+                nodes[path[i]].totalValue += value;
+            }
+        }
+        valueScale = std::max(valueScale, value);
+    }
+
+    // Search from rootGame until budgetSeconds have passed or maxIterations are done, then return the most visited action
+    template <typename RootGame>
+    SnakeActions search(const RootGame &rootGame, uint32_t &randSeed, const double budgetSeconds, const int maxIterations = std::numeric_limits<int>::max())
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(budgetSeconds);
+
+        int rootMark = 0;
+        if constexpr (std::is_same<Game, SnakeGame>::value)
+        {
+            scratchGame.copyState(rootGame);
+            rootMark = scratchGame.checkpoint();
+        }
+        else
+        {
+            rootState.copyState(rootGame);
+        }
+
+        lastIterations = 0;
+        while (lastIterations < maxIterations)
+        {
+            // Checking the clock every iteration costs more than a short rollout
+            if ((lastIterations & 15) == 0 && std::chrono::steady_clock::now() >= deadline)
+            {
+                break;
+            }
+
+            if constexpr (std::is_same<Game, SnakeGame>::value)
+            {
+                scratchGame.rewind(rootMark);
+            }
+            else
+            {
+                scratchGame.copyState(rootState);
+            }
+            iterate(randSeed);
+            lastIterations++;
+        }
+
+        return getBestAction();
+    }
+
+    SnakeActions getBestAction() const
+    {
+        int bestAction = SnakeActions::NO_TURN;
+        int bestVisits = -1;
+        for (int action = 0; action < 3; action++)
+        {
+            const int child = nodes[root].children[action];
+            const int visits = child >= 0 ? nodes[child].visits : 0;
+            if (visits > bestVisits)
+            {
+                bestVisits = visits;
+                bestAction = action;
+            }
+        }
+        return (SnakeActions)bestAction;
+    }
+
+    // Move the root to the subtree for action, given the game after the action was taken
+    template <typename RootGame>
+    void advance(SnakeActions action, const RootGame &newGame)
+    {
+        int child = nodes[root].children[action];
+        if (child >= 0 && nodes[child].type == CHANCE)
+        {
+            child = findOutcome(child, newGame.applePosition);
+        }
+        if (child < 0 || nodes[child].type != DECISION)
+        {
+            resetTree();
+            return;
+        }
+
+        root = child;
+        if ((int)nodes.size() > maxNodes / 2)
+        {
+            compact();
+        }
+    }
+
+    // Drop every node not under the root
+    void compact()
+    {
+        std::vector<Node> kept;
+        std::vector<int> newIndex(nodes.size(), -1);
+        std::vector<int> queue = {root};
+        newIndex[root] = 0;
+        kept.push_back(nodes[root]);
+        for (size_t i = 0; i < queue.size(); i++)
+        {
+            const Node &node = nodes[queue[i]];
+            auto keep = [&](int oldIndex)
+            {
+                if (oldIndex >= 0 && newIndex[oldIndex] < 0)
+                {
+                    newIndex[oldIndex] = (int)kept.size();
+                    kept.push_back(nodes[oldIndex]);
+                    queue.push_back(oldIndex);
+                }
+            };
+            for (int action = 0; action < 3; action++)
+            {
+                keep(node.children[action]);
+            }
+            for (int child = node.firstOutcome; child >= 0; child = nodes[child].nextOutcome)
+            {
+                keep(child);
+            }
+        }
+
+        for (Node &node : kept)
+        {
+            for (int action = 0; action < 3; action++)
+            {
+                node.children[action] = node.children[action] >= 0 ? newIndex[node.children[action]] : -1;
+            }
+            node.firstOutcome = node.firstOutcome >= 0 ? newIndex[node.firstOutcome] : -1;
+            node.nextOutcome = node.nextOutcome >= 0 ? newIndex[node.nextOutcome] : -1;
+        }
+        kept[0].nextOutcome = -1;
+
+        nodes.swap(kept);
+        root = 0;
+    }
+};
+
+#endif
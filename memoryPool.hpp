@@ -0,0 +1,171 @@
+#ifndef MEMORY_POOL_HPP
+#define MEMORY_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+/*
+Reusable buffers for Matrix and SnakeGame.
+
+Buffers are rounded up to a power of two, 64-byte aligned, and handed back to a per-thread free
+list when released instead of being deleted. Once a loop has created and destroyed each size it
+needs once, it stops touching the heap.
+
+Define COUNT_ALLOCATIONS before including this header to replace global new/delete with versions
+that count every heap allocation, then read getAllocationCount() around the code being checked.
+*/
+
+#ifdef COUNT_ALLOCATIONS
+std::atomic<uint64_t> allocationCount{0};
+
+static void *countedAlloc(std::size_t bytes, std::size_t alignment)
+{
+    allocationCount++;
+    bytes = bytes == 0 ? 1 : bytes;
+#ifdef _WIN32
+    void *ptr = _aligned_malloc(bytes, alignment);
+#else
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, alignment < sizeof(void *) ? sizeof(void *) : alignment, bytes) != 0)
+    {
+        ptr = nullptr;
+    }
+#endif
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+static void countedFree(void *ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void *operator new(std::size_t bytes) { return countedAlloc(bytes, alignof(std::max_align_t)); }
+void *operator new[](std::size_t bytes) { return countedAlloc(bytes, alignof(std::max_align_t)); }
+void *operator new(std::size_t bytes, std::align_val_t alignment) { return countedAlloc(bytes, (std::size_t)alignment); }
+void *operator new[](std::size_t bytes, std::align_val_t alignment) { return countedAlloc(bytes, (std::size_t)alignment); }
+void operator delete(void *ptr) noexcept { countedFree(ptr); }
+void operator delete[](void *ptr) noexcept { countedFree(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { countedFree(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { countedFree(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { countedFree(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { countedFree(ptr); }
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept { countedFree(ptr); }
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept { countedFree(ptr); }
+
+uint64_t getAllocationCount()
+{
+    return allocationCount.load();
+}
+#else
+uint64_t getAllocationCount()
+{
+    return 0;
+}
+#endif
+
+struct BufferPool
+{
+    static constexpr std::size_t alignment = 64;
+    static constexpr int minSizeClass = 6; // 64 bytes
+    static constexpr int numSizeClasses = 48;
+
+    std::vector<void *> freeLists[numSizeClasses];
+
+    static bool &destroyed()
+    {
+        thread_local bool poolDestroyed = false;
+        return poolDestroyed;
+    }
+
+    ~BufferPool()
+    {
+        for (int i = 0; i < numSizeClasses; i++)
+        {
+            for (void *ptr : freeLists[i])
+            {
+                ::operator delete(ptr, std::align_val_t(alignment));
+            }
+        }
+        destroyed() = true;
+    }
+
+    static int getSizeClass(std::size_t bytes)
+    {
+        int sizeClass = minSizeClass;
+        while (((std::size_t)1 << sizeClass) < bytes)
+        {
+            sizeClass++;
+        }
+        return sizeClass;
+    }
+
+    void *acquire(std::size_t bytes)
+    {
+        if (bytes == 0)
+        {
+            return nullptr;
+        }
+        const int sizeClass = getSizeClass(bytes);
+        if (!freeLists[sizeClass].empty())
+        {
+            void *ptr = freeLists[sizeClass].back();
+            freeLists[sizeClass].pop_back();
+            return ptr;
+        }
+        return ::operator new((std::size_t)1 << sizeClass, std::align_val_t(alignment));
+    }
+
+    void release(void *ptr, std::size_t bytes)
+    {
+        if (ptr == nullptr)
+        {
+            return;
+        }
+        freeLists[getSizeClass(bytes)].push_back(ptr);
+    }
+};
+
+BufferPool &getBufferPool()
+{
+    thread_local BufferPool pool;
+    return pool;
+}
+
+template <typename T>
+T *poolAcquire(int count)
+{
+    return (T *)getBufferPool().acquire(count * sizeof(T));
+}
+
+template <typename T>
+void poolRelease(T *ptr, int count)
+{
+    // Objects that outlive this thread's pool (statics destroyed after thread locals) just free their buffer
+    if (BufferPool::destroyed())
+    {
+        if (ptr != nullptr)
+        {
+            ::operator delete((void *)ptr, std::align_val_t(BufferPool::alignment));
+        }
+        return;
+    }
+    getBufferPool().release(ptr, count * sizeof(T));
+}
+
+#endif
@@ -1,18 +1,27 @@
 #ifndef NEURAL_NET_HPP
+#define NEURAL_NET_HPP
 
+#include <cassert>
 #include <iomanip>
 #include <iostream>
 #include <cmath>
 #include <fstream>
+#include <memory>
+#include <vector>
 
 #include "random.hpp"
+#include "memoryPool.hpp"
+#include "simd.hpp"
+#include "crc32.hpp"
+#include "mappedFile.hpp"
 
 struct Matrix
 {
     int rows = 0;
     int cols = 0;
     int numValues = 0;
-    float *values;
+    float *values = nullptr; // 64-byte aligned, from the buffer pool, so rows start on a cache line for the SIMD kernels
+    bool ownsValues = true;  // False for views into a buffer someone else owns, see view()
 
     Matrix() {}
 
@@ -21,72 +30,146 @@ struct Matrix
         rows = _rows;
         cols = _cols;
         numValues = rows * cols;
-        values = new float[numValues];
+        values = poolAcquire<float>(numValues);
         zeros();
     }
 
-    // This starts making problems when the bezier curves are in a std::vector
-    ~Matrix()
+    // Copying a view gives an owning copy of its values
+    Matrix(const Matrix &other)
+        : Matrix(other.rows, other.cols)
     {
-        delete[] values;
+        copy(other);
     }
 
-    void mul(const float val)
+    Matrix(Matrix &&other) noexcept
     {
-        for (int i = 0; i < numValues; i++)
+        swap(other);
+    }
+
+    Matrix &operator=(const Matrix &other)
+    {
+        if (this != &other)
         {
-            values[i] *= val;
+            if (numValues != other.numValues)
+            {
+                if (!ownsValues)
+                {
+                    throw std::runtime_error("Error: Cannot resize a Matrix view");
+                }
+                poolRelease(values, numValues);
+                values = poolAcquire<float>(other.numValues);
+            }
+            rows = other.rows;
+            cols = other.cols;
+            numValues = other.numValues;
+            copy(other);
         }
+        return *this;
     }
 
-    void add(const Matrix &other)
+    Matrix &operator=(Matrix &&other) noexcept
     {
-        for (int i = 0; i < numValues; i++)
+        swap(other);
+        return *this;
+    }
+
+    ~Matrix()
+    {
+        if (ownsValues)
         {
-            values[i] += other.values[i];
+            poolRelease(values, numValues);
         }
     }
 
+    // (rows, cols) matrix over values it does not own, the owner has to outlive it
+    static Matrix view(float *values, int rows, int cols)
+    {
+        Matrix matrix;
+        matrix.rows = rows;
+        matrix.cols = cols;
+        matrix.numValues = rows * cols;
+        matrix.values = values;
+        matrix.ownsValues = false;
+        return matrix;
+    }
+
+    void swap(Matrix &other) noexcept
+    {
+        std::swap(rows, other.rows);
+        std::swap(cols, other.cols);
+        std::swap(numValues, other.numValues);
+        std::swap(values, other.values);
+        std::swap(ownsValues, other.ownsValues);
+    }
+
+    void mul(const float val)
+    {
+        simdMul(values, val, numValues);
+    }
+
+    void add(const Matrix &other)
+    {
+        simdAddScaled(values, other.values, 1.0f, numValues);
+    }
+
+    void addScaled(const Matrix &other, const float scale)
+    {
+        simdAddScaled(values, other.values, scale, numValues);
+    }
+
     void addOther(const Matrix &other, int start, int stop)
     {
-        for (int i = start; i < stop; i++)
-        {
-            values[i] += other.values[i - start];
-        }
+        simdAddScaled(&values[start], other.values, 1.0f, stop - start);
     }
 
     void otherAdd(const Matrix &other, int start, int stop)
     {
-        for (int i = start; i < stop; i++)
-        {
-            values[i - start] += other.values[i];
-        }
+        simdAddScaled(values, &other.values[start], 1.0f, stop - start);
     }
 
     void sub(const Matrix &other)
     {
-        for (int i = 0; i < numValues; i++)
-        {
-            values[i] -= other.values[i];
-        }
+        simdAddScaled(values, other.values, -1.0f, numValues);
     }
 
-    void addRand(uint32_t &randSeed, const float std)
+    // fastNoise draws from the vectorized counter-based generator (simdNormals) instead of randDist, a
+    // different stream that is just as reproducible. It keys the whole call off one step of randSeed
+    void addRand(uint32_t &randSeed, const float std, bool fastNoise = false)
     {
+        if (fastNoise)
+        {
+            randSeed = PCG_Hash(randSeed);
+            simdNormals(values, randSeed, std, true, numValues);
+            return;
+        }
         for (int i = 0; i < numValues; i++)
         {
             values[i] += randDist(0.0f, std, randSeed);
         }
     }
 
-    void setRand(uint32_t &randSeed, const float std)
+    void setRand(uint32_t &randSeed, const float std, bool fastNoise = false)
     {
+        if (fastNoise)
+        {
+            randSeed = PCG_Hash(randSeed);
+            simdNormals(values, randSeed, std, false, numValues);
+            return;
+        }
         for (int i = 0; i < numValues; i++)
         {
             values[i] = randDist(0.0f, std, randSeed);
         }
     }
 
+    // values[start, stop) += the same slice of the noise addRand(randSeed, std, true) would add, without advancing randSeed.
+    // start must be even: value i of the stream for a key is value i - start of the stream for key + start
+    void addFastRandRange(uint32_t randSeed, const float std, int start, int stop)
+    {
+        assert((start & 1) == 0);
+        simdNormals(&values[start], PCG_Hash(randSeed) + (uint32_t)start, std, true, stop - start);
+    }
+
     void zeros()
     {
         for (int i = 0; i < numValues; i++)
@@ -95,7 +178,7 @@ struct Matrix
         }
     }
 
-    void copy(Matrix &other)
+    void copy(const Matrix &other)
     {
         for (int i = 0; i < numValues; i++)
         {
@@ -142,26 +225,131 @@ struct Matrix
 
     float normSquared()
     {
-        float val = 0.0f;
-        for (int i = 0; i < numValues; i++)
+        return simdDiffSquared(values, nullptr, numValues);
+    }
+
+    float diffSquared(Matrix &other)
+    {
+        return simdDiffSquared(values, other.values, numValues);
+    }
+
+    float dot(const Matrix &other) const
+    {
+        return simdDot(values, other.values, numValues);
+    }
+};
+
+/*
+board @ weight0 carried across game steps.
+
+A move shifts every body value down by one (the tail drops to 0) and gives the new head the
+snake's length, so
+
+    newBoard @ weight0 = board @ weight0 - (sum of the weight0 rows under the snake) + length * weight0[head]
+
+Keeping that row sum next to the product makes each step O(hiddenSize) instead of
+O(size * size * hiddenSize). refresh() does the full product, after a reset or a copied state.
+weight0 can be a Matrix or a FixedMatrix, anything with rows and values.
+*/
+struct HiddenAccumulator
+{
+    Matrix preActivation; // board @ weight0
+    Matrix occupiedSum;   // Sum of the weight0 rows of the cells under the snake
+
+    HiddenAccumulator() {}
+
+    HiddenAccumulator(int hiddenSize)
+        : preActivation(1, hiddenSize),
+          occupiedSum(1, hiddenSize)
+    {
+    }
+
+    template <typename Weights>
+    void refresh(const Weights &weight0, const uint8_t *board)
+    {
+        const int hiddenSize = preActivation.numValues;
+        preActivation.zeros();
+        occupiedSum.zeros();
+        for (int i = 0; i < weight0.rows; i++)
         {
-            val += values[i] * values[i];
+            if (board[i] == 0)
+            {
+                continue;
+            }
+            const float *row = &weight0.values[i * hiddenSize];
+            simdAddScaled(preActivation.values, row, (float)board[i], hiddenSize);
+            simdAddScaled(occupiedSum.values, row, 1.0f, hiddenSize);
         }
-        return val;
     }
 
-    float diffSquared(Matrix &other)
+    // The tail left tailPosition and the head entered headPosition, length did not change
+    template <typename Weights>
+    void move(const Weights &weight0, int tailPosition, int headPosition, int length)
     {
-        float val = 0.0f;
-        for (int i = 0; i < numValues; i++)
+        const int hiddenSize = preActivation.numValues;
+        const float *tailRow = &weight0.values[tailPosition * hiddenSize];
+        const float *headRow = &weight0.values[headPosition * hiddenSize];
+        simdAddScaled(preActivation.values, headRow, (float)length, hiddenSize);
+        simdAddScaled(preActivation.values, occupiedSum.values, -1.0f, hiddenSize);
+        simdAddScaled(occupiedSum.values, headRow, 1.0f, hiddenSize);
+        simdAddScaled(occupiedSum.values, tailRow, -1.0f, hiddenSize);
+    }
+
+    // The snake ate, the head entered headPosition and length is the new length
+    template <typename Weights>
+    void grow(const Weights &weight0, int headPosition, int length)
+    {
+        const int hiddenSize = preActivation.numValues;
+        const float *headRow = &weight0.values[headPosition * hiddenSize];
+        simdAddScaled(preActivation.values, headRow, (float)length, hiddenSize);
+        simdAddScaled(occupiedSum.values, headRow, 1.0f, hiddenSize);
+    }
+
+    // Catch up with a game that just stepped without dying, given its tail and length before the step
+    template <typename Weights, typename Game>
+    void update(const Weights &weight0, const Game &game, int oldTailPosition, int oldLength)
+    {
+        if (game.bodyLength > oldLength)
         {
-            float diff = values[i] - other.values[i];
-            val += diff * diff;
+            grow(weight0, game.snakeHeadPosition, game.bodyLength);
+        }
+        else
+        {
+            move(weight0, oldTailPosition, game.snakeHeadPosition, game.bodyLength);
         }
-        return val;
     }
 };
 
+/*
+Model file, version 2:
+
+A 64-byte ModelFileHeader, then weight0, weight1 and weight2 as float32, each starting on a 64-byte
+boundary (zero padding in between). dataCrc is the CRC-32 of everything after the header. When
+weight0 and weight1 fill whole cache lines, which they do whenever size * size * hiddenSize is a
+multiple of 16, the three tensors are back to back, exactly like SnakeModel::params, so
+SnakeModel::mapFromFile can use the mapped file as the model without copying anything.
+
+Version 1 files, from before the header, are just two ints (size, hiddenSize) and the three tensors.
+They are still read, and are told apart by their missing magic.
+*/
+struct ModelFileHeader
+{
+    char magic[8];           // "SNAKEMDL"
+    uint32_t version;        // 2
+    uint32_t architecture;   // MODEL_ARCHITECTURE_SNAKE
+    uint32_t dtype;          // MODEL_DTYPE_FLOAT32
+    uint32_t size;           // Board size
+    uint32_t hiddenSize;
+    uint32_t dataCrc;
+    uint64_t tensorOffsets[3]; // weight0, weight1, weight2, from the start of the file
+    uint64_t fileSize;
+};
+static_assert(sizeof(ModelFileHeader) == 64, "Model tensors must start 64-byte aligned");
+
+constexpr uint32_t MODEL_FILE_VERSION = 2;
+constexpr uint32_t MODEL_ARCHITECTURE_SNAKE = 1; // activation((board @ weight0) * weight1[applePos]) @ weight2
+constexpr uint32_t MODEL_DTYPE_FLOAT32 = 1;
+
 /*
 Snake Model:
 
@@ -171,11 +359,19 @@ weight1 (size * size, hiddenSize)
 weight2 (hiddenSize, 3)
 nParams = 2 * size * size * hiddenSize + hiddenSize * 3
 
-out = activation(board @ weight0 + weight1[applePos]) @ weight2
+out = activation((board @ weight0) * weight1[applePos]) @ weight2, the product elementwise
+
+All parameters live in params, one flat buffer with weight0, weight1 and weight2 back to back, and
+the weight matrices are views into it. Copying, perturbing, the gradient step and the file format
+all work on params in one pass.
+
+A model from mapFromFile has params pointing into a read-only file mapping. It is for inference,
+anything that writes its weights has to work on a copy.
 */
 
 struct SnakeModel
 {
+    Matrix params; // (1, nParams), declared before the views into it
     Matrix weight0;
     Matrix weight1;
     Matrix weight2;
@@ -185,43 +381,94 @@ struct SnakeModel
     int size;
     int hiddenSize;
 
+    std::shared_ptr<MappedFile> mappedFile; // Keeps the file open when params points into it
+
     SnakeModel(int _size, int _hiddenSize)
-        : weight0(_size * _size, _hiddenSize),
-          weight1(_size * _size, _hiddenSize),
-          weight2(_hiddenSize, 3),
+        : SnakeModel(_size, _hiddenSize, Matrix(1, 2 * _size * _size * _hiddenSize + _hiddenSize * 3))
+    {
+    }
+
+    // Model over a (1, nParams) params Matrix, which can be a view of weights held elsewhere
+    SnakeModel(int _size, int _hiddenSize, Matrix &&_params)
+        : params(std::move(_params)),
+          weight0(Matrix::view(params.values, _size * _size, _hiddenSize)),
+          weight1(Matrix::view(&params.values[_size * _size * _hiddenSize], _size * _size, _hiddenSize)),
+          weight2(Matrix::view(&params.values[2 * _size * _size * _hiddenSize], _hiddenSize, 3)),
           hidden(1, _hiddenSize)
     {
         size = _size;
         hiddenSize = _hiddenSize;
     }
 
+    // The views have to point into the copy's own params, so copies go through copyWeights
+    SnakeModel(const SnakeModel &other)
+        : SnakeModel(other.size, other.hiddenSize)
+    {
+        copyWeights(other);
+    }
+
+    SnakeModel &operator=(const SnakeModel &other)
+    {
+        // A mapped model's weights are read-only, it gets weights of its own
+        if (size != other.size || hiddenSize != other.hiddenSize || mappedFile != nullptr)
+        {
+            *this = SnakeModel(other);
+        }
+        else
+        {
+            copyWeights(other);
+        }
+        return *this;
+    }
+
+    // Moving params moves the buffer the views point into along with them
+    SnakeModel(SnakeModel &&other) = default;
+    SnakeModel &operator=(SnakeModel &&other) = default;
+
     int getNumParams()
     {
-        return weight0.numValues + weight1.numValues + weight2.numValues;
+        return params.numValues;
+    }
+
+    void copyWeights(const SnakeModel &other)
+    {
+        params.copy(other.params);
+    }
+
+    void addRand(uint32_t &randSeed, const float std, bool fastNoise = false)
+    {
+        params.addRand(randSeed, std, fastNoise);
     }
 
-    void copyWeights(SnakeModel &other)
+    void setRand(uint32_t &randSeed, const float std, bool fastNoise = false)
     {
-        weight0.copy(other.weight0);
-        weight1.copy(other.weight1);
-        weight2.copy(other.weight2);
+        params.setRand(randSeed, std, fastNoise);
     }
 
-    void addRand(uint32_t &randSeed, const float std)
+    static uint64_t alignFileOffset(uint64_t offset)
     {
-        weight0.addRand(randSeed, std);
-        weight1.addRand(randSeed, std);
-        weight2.addRand(randSeed, std);
+        return (offset + 63) & ~(uint64_t)63;
     }
 
-    void setRand(uint32_t &randSeed, const float std)
+    // Header for a model of these dimensions, everything but dataCrc
+    static ModelFileHeader makeFileHeader(int size, int hiddenSize)
     {
-        weight0.setRand(randSeed, std);
-        weight1.setRand(randSeed, std);
-        weight2.setRand(randSeed, std);
+        ModelFileHeader header = {};
+        std::memcpy(header.magic, "SNAKEMDL", 8);
+        header.version = MODEL_FILE_VERSION;
+        header.architecture = MODEL_ARCHITECTURE_SNAKE;
+        header.dtype = MODEL_DTYPE_FLOAT32;
+        header.size = size;
+        header.hiddenSize = hiddenSize;
+        const uint64_t weightBytes = (uint64_t)size * size * hiddenSize * sizeof(float);
+        header.tensorOffsets[0] = sizeof(ModelFileHeader);
+        header.tensorOffsets[1] = alignFileOffset(header.tensorOffsets[0] + weightBytes);
+        header.tensorOffsets[2] = alignFileOffset(header.tensorOffsets[1] + weightBytes);
+        header.fileSize = alignFileOffset(header.tensorOffsets[2] + (uint64_t)hiddenSize * 3 * sizeof(float));
+        return header;
     }
 
-    // Serialize the model to a binary file
+    // Serialize the model to a version 2 binary file
     bool saveToFile(const std::string &filename) const
     {
         std::ofstream file(filename, std::ios::binary);
@@ -231,21 +478,72 @@ struct SnakeModel
             return false;
         }
 
-        // Write size and hiddenSize
-        file.write(reinterpret_cast<const char *>(&size), sizeof(int));
-        file.write(reinterpret_cast<const char *>(&hiddenSize), sizeof(int));
+        ModelFileHeader header = makeFileHeader(size, hiddenSize);
+        std::vector<uint8_t> data(header.fileSize - sizeof(ModelFileHeader), 0);
+        const Matrix *weights[3] = {&weight0, &weight1, &weight2};
+        for (int t = 0; t < 3; t++)
+        {
+            std::memcpy(&data[header.tensorOffsets[t] - sizeof(ModelFileHeader)], weights[t]->values, weights[t]->numValues * sizeof(float));
+        }
+        header.dataCrc = crc32(data.data(), data.size());
 
-        // Write weight matrices
-        file.write(reinterpret_cast<const char *>(weight0.values), weight0.numValues * sizeof(float));
-        file.write(reinterpret_cast<const char *>(weight1.values), weight1.numValues * sizeof(float));
-        file.write(reinterpret_cast<const char *>(weight2.values), weight2.numValues * sizeof(float));
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(data.data()), data.size());
+        return (bool)file;
+    }
 
-        file.close();
-        return true;
+    // Throws if a mapped file is not a valid version 2 model
+    static const ModelFileHeader &checkFileHeader(const MappedFile &file, const std::string &filename)
+    {
+        const ModelFileHeader &header = *(const ModelFileHeader *)file.data;
+        if (file.size < sizeof(ModelFileHeader) || std::memcmp(header.magic, "SNAKEMDL", 8) != 0)
+        {
+            throw std::runtime_error("Error: Not a model file: " + filename);
+        }
+        if (header.version != MODEL_FILE_VERSION || header.architecture != MODEL_ARCHITECTURE_SNAKE || header.dtype != MODEL_DTYPE_FLOAT32)
+        {
+            throw std::runtime_error("Error: Unsupported model file version " + std::to_string(header.version) + " (architecture " +
+                                     std::to_string(header.architecture) + ", dtype " + std::to_string(header.dtype) + "): " + filename);
+        }
+        const ModelFileHeader expected = makeFileHeader(header.size, header.hiddenSize);
+        if (file.size != expected.fileSize || header.fileSize != expected.fileSize ||
+            std::memcmp(header.tensorOffsets, expected.tensorOffsets, sizeof(expected.tensorOffsets)) != 0)
+        {
+            throw std::runtime_error("Error: Model file is truncated or its layout does not match its dimensions: " + filename);
+        }
+        if (crc32(file.data + sizeof(ModelFileHeader), file.size - sizeof(ModelFileHeader)) != header.dataCrc)
+        {
+            throw std::runtime_error("Error: Model file checksum mismatch: " + filename);
+        }
+        return header;
+    }
+
+    static bool isVersion2File(const MappedFile &file)
+    {
+        return file.size >= 8 && std::memcmp(file.data, "SNAKEMDL", 8) == 0;
     }
 
-    // Deserialize the model from a binary file
+    // Deserialize the model from a binary file of either version into weights of its own
     static SnakeModel loadFromFile(const std::string &filename)
+    {
+        MappedFile file;
+        if (file.open(filename) && isVersion2File(file))
+        {
+            const ModelFileHeader &header = checkFileHeader(file, filename);
+            SnakeModel loadedModel(header.size, header.hiddenSize);
+            Matrix *weights[3] = {&loadedModel.weight0, &loadedModel.weight1, &loadedModel.weight2};
+            for (int t = 0; t < 3; t++)
+            {
+                std::memcpy(weights[t]->values, file.data + header.tensorOffsets[t], weights[t]->numValues * sizeof(float));
+            }
+            return loadedModel;
+        }
+        file.close();
+        return loadFromLegacyFile(filename);
+    }
+
+    // Version 1: size, hiddenSize, then the tensors with no header
+    static SnakeModel loadFromLegacyFile(const std::string &filename)
     {
         std::ifstream file(filename, std::ios::binary);
         if (!file.is_open())
@@ -259,57 +557,77 @@ struct SnakeModel
 
         SnakeModel loadedModel(loadedSize, loadedHiddenSize);
 
-        // Read weight matrices
-        file.read(reinterpret_cast<char *>(loadedModel.weight0.values), loadedModel.weight0.numValues * sizeof(float));
-        file.read(reinterpret_cast<char *>(loadedModel.weight1.values), loadedModel.weight1.numValues * sizeof(float));
-        file.read(reinterpret_cast<char *>(loadedModel.weight2.values), loadedModel.weight2.numValues * sizeof(float));
+        // Read weight0, weight1 and weight2 into params
+        file.read(reinterpret_cast<char *>(loadedModel.params.values), loadedModel.params.numValues * sizeof(float));
 
         file.close();
         return loadedModel;
     }
 
+    /*
+    Maps a version 2 file and uses it as the model's params in place, so loading costs one checksum
+    pass and the pages are shared with every other process that maps the same model. The mapping is
+    read-only. Version 1 files, and version 2 files whose tensors are not back to back, fall back to
+    loadFromFile.
+    */
+    static SnakeModel mapFromFile(const std::string &filename)
+    {
+        std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+        if (!file->open(filename) || !isVersion2File(*file))
+        {
+            return loadFromFile(filename);
+        }
+        const ModelFileHeader &header = checkFileHeader(*file, filename);
+        const uint64_t weightBytes = (uint64_t)header.size * header.size * header.hiddenSize * sizeof(float);
+        if (header.tensorOffsets[1] != header.tensorOffsets[0] + weightBytes || header.tensorOffsets[2] != header.tensorOffsets[1] + weightBytes)
+        {
+            return loadFromFile(filename);
+        }
+
+        const int numParams = 2 * header.size * header.size * header.hiddenSize + header.hiddenSize * 3;
+        float *mappedParams = (float *)(file->data + header.tensorOffsets[0]);
+        SnakeModel mappedModel(header.size, header.hiddenSize, Matrix::view(mappedParams, 1, numParams));
+        mappedModel.mappedFile = file;
+        return mappedModel;
+    }
+
     void forward(const uint8_t *board, const int applePos, Matrix &out)
     {
         // hidden = board @ weight0
         hidden.zeros();
         for (int i = 0; i < size * size; i++)
         {
-            for (int j = 0; j < hiddenSize; j++)
+            // Empty cells add nothing
+            if (board[i] != 0)
             {
-                hidden.values[j] += board[i] * weight0.values[i * hiddenSize + j];
+                simdAddScaled(hidden.values, &weight0.values[i * hiddenSize], (float)board[i], hiddenSize);
             }
         }
         // hidden.print("hidden");
 
-        // hidden = activation(hidden * weight1[applePos])
+        forwardHidden(applePos, out);
+    }
+
+    // Same as forward, with board @ weight0 taken from an accumulator the game loop keeps up to date
+    void forward(const HiddenAccumulator &accumulator, const int applePos, Matrix &out)
+    {
         for (int j = 0; j < hiddenSize; j++)
         {
-            const float x = hidden.values[j] * weight1.values[applePos * hiddenSize + j];
-
-            if (x < -1.0f)
-            {
-                hidden.values[j] = -1.0f;
-            }
-            else if (x > 1.0f)
-            {
-                hidden.values[j] = 1.0f;
-            }
-            else
-            {
-                hidden.values[j] = (x + x) / (x * x + 1.0f);
-            }
+            hidden.values[j] = accumulator.preActivation.values[j];
         }
+        forwardHidden(applePos, out);
+    }
+
+    // Rest of the forward pass once hidden holds board @ weight0
+    void forwardHidden(const int applePos, Matrix &out)
+    {
+        // hidden = activation(hidden * weight1[applePos]), (x + x) / (x * x + 1) clamped to [-1, 1]
+        simdActivation(hidden.values, &weight1.values[applePos * hiddenSize], hiddenSize);
 
         // hidden.print("hidden");
 
         // out = hidden @ weight2
-        out.zeros();
-        for (int i = 0; i < hiddenSize; i++)
-        {
-            out.values[0] += hidden.values[i] * weight2.values[i * 3 + 0];
-            out.values[1] += hidden.values[i] * weight2.values[i * 3 + 1];
-            out.values[2] += hidden.values[i] * weight2.values[i * 3 + 2];
-        }
+        simdMatVec3(hidden.values, weight2.values, hiddenSize, out.values);
 
         // out.print("out");
     }
@@ -348,21 +666,10 @@ struct AdamOptimizer
         const float beta2Minus = 1.0f - beta2;
         const float mHatMul = 1.0f / (1.0f - beta1Power);
         const float vHatMul = 1.0f / (1.0f - beta2Power);
-        for (int i = 0; i < nParams; i++)
-        {
-            // Compute m and mHat
-            const float mVal = beta1 * m.values[i] + beta1Minus * grad.values[i];
-            m.values[i] = mVal;
-            const float mHatVal = mVal * mHatMul;
-
-            // Compute v and vHat
-            const float vVal = beta2 * v.values[i] + beta2Minus * grad.values[i] * grad.values[i];
-            v.values[i] = vVal;
-            const float vHatVal = vVal * vHatMul;
-
-            // Compute new grad
-            grad.values[i] = alpha * mHatVal / (sqrtf(vHatVal) + eps);
-        }
+
+        // m = beta1 * m + (1 - beta1) * grad, v = beta2 * v + (1 - beta2) * grad^2, grad = alpha * mHat / (sqrt(vHat) + eps)
+        const AdamConstants constants = {beta1, beta2, beta1Minus, beta2Minus, mHatMul, vHatMul, alpha, eps};
+        simdAdam(m.values, v.values, grad.values, constants, nParams);
 
         // Increase values
         beta1Power *= beta1;
@@ -0,0 +1,79 @@
+#ifndef NOISE_TABLE_HPP
+#define NOISE_TABLE_HPP
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "neuralNet.hpp"
+
+/*
+Shared table of standard normal values for evolution strategies, as in OpenAI's ES.
+
+The table is filled once from a seed. A perturbation is then a NoisePerturbation, a 64-byte
+aligned offset into the table and a sign, and its noise is sign * the numParams values from that
+offset. Perturbing a model and adding a trial to the gradient both become one scaled add from the
+table, with no normals drawn per trial. Slices of different trials overlap, which is fine as long
+as the table is much larger than the model.
+
+Nothing writes to the table after construction, so any number of threads can read it.
+*/
+
+struct NoisePerturbation
+{
+    uint32_t offset = 0;
+    float sign = 1.0f;
+};
+
+struct NoiseTable
+{
+    Matrix noise;
+
+    NoiseTable(int numValues, uint32_t randSeed)
+        : noise(1, numValues)
+    {
+        simdNormals(noise.values, randSeed, 1.0f, false, numValues);
+    }
+
+    // Offset and sign for a model of numParams values, offsets are multiples of 16 so every slice starts on a cache line
+    NoisePerturbation samplePerturbation(uint32_t &randSeed, int numParams) const
+    {
+        if (numParams > noise.numValues)
+        {
+            throw std::runtime_error("Error: Noise table of " + std::to_string(noise.numValues) + " values is smaller than a model of " +
+                                     std::to_string(numParams) + " parameters");
+        }
+        const uint32_t numOffsets = (uint32_t)(noise.numValues - numParams) / 16 + 1;
+        randSeed = PCG_Hash(randSeed);
+        NoisePerturbation perturbation;
+        perturbation.offset = (randSeed % numOffsets) * 16;
+        perturbation.sign = (randSeed >> 31) ? -1.0f : 1.0f;
+        return perturbation;
+    }
+
+    // dst += scale * the perturbation's noise, scale is sigma to perturb weights or sigma * score to add to a gradient
+    void addNoise(Matrix &dst, const NoisePerturbation &perturbation, const float scale) const
+    {
+        simdAddScaled(dst.values, &noise.values[perturbation.offset], perturbation.sign * scale, dst.numValues);
+    }
+
+    // Same as addNoise for dst[start, stop) only
+    void addNoise(Matrix &dst, const NoisePerturbation &perturbation, const float scale, int start, int stop) const
+    {
+        simdAddScaled(&dst.values[start], &noise.values[perturbation.offset + start], perturbation.sign * scale, stop - start);
+    }
+
+    // dst = base + scale * the perturbation's noise, a copy and addNoise in one pass
+    void perturb(const Matrix &base, Matrix &dst, const NoisePerturbation &perturbation, const float scale) const
+    {
+        simdAddScaledTo(dst.values, base.values, &noise.values[perturbation.offset], perturbation.sign * scale, dst.numValues);
+    }
+
+    // The perturbation's noise dotted with other
+    float dot(const NoisePerturbation &perturbation, const Matrix &other) const
+    {
+        return perturbation.sign * simdDot(&noise.values[perturbation.offset], other.values, other.numValues);
+    }
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef POLICY_TABLE_HPP
+#define POLICY_TABLE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "game.hpp"
+#include "mappedFile.hpp"
+
+/*
+Optimal action for every reachable position of a small board, written by solve.cpp.
+
+The table is an open addressing hash table keyed by the game's Zobrist hash, so a lookup is one
+probe sequence on the hash the game already keeps up to date. Each slot is one uint64_t holding
+the hash with its low 2 bits replaced by the action, 0 marks an empty slot. solve.cpp checks that
+no two reachable positions share the upper 62 bits of their hash.
+
+File layout: a 64-byte PolicyTableHeader, then numSlots slots. The file is memory-mapped, not read.
+*/
+
+struct PolicyTableHeader
+{
+    char magic[8];       // "SNAKEPOL"
+    uint32_t version;
+    uint32_t size;       // Board size the table was solved for
+    uint64_t numSlots;   // Power of two
+    uint64_t numStates;  // Reachable positions in the table
+    double optimalScore; // Expected apples of the optimal policy from a reset game, with no step limit
+    uint8_t padding[24];
+};
+static_assert(sizeof(PolicyTableHeader) == 64, "Policy table slots must start 64-byte aligned");
+
+std::string getPolicyTablePath(int size)
+{
+    return "policyTables/policy" + std::to_string(size) + "x" + std::to_string(size) + ".bin";
+}
+
+struct PolicyTable
+{
+    static constexpr uint32_t version = 1;
+    static constexpr uint64_t keyMask = ~(uint64_t)3;
+
+    MappedFile file;
+    const PolicyTableHeader *header = nullptr;
+    const uint64_t *slots = nullptr;
+    uint64_t slotMask = 0;
+
+    // Returns false if the file is missing or was solved for another board size
+    bool load(const std::string &path, int size)
+    {
+        header = nullptr;
+        slots = nullptr;
+        if (!file.open(path) || file.size < sizeof(PolicyTableHeader))
+        {
+            return false;
+        }
+        const PolicyTableHeader *fileHeader = (const PolicyTableHeader *)file.data;
+        if (std::memcmp(fileHeader->magic, "SNAKEPOL", 8) != 0 || fileHeader->version != version || (int)fileHeader->size != size ||
+            file.size != sizeof(PolicyTableHeader) + fileHeader->numSlots * sizeof(uint64_t))
+        {
+            file.close();
+            return false;
+        }
+        header = fileHeader;
+        slots = (const uint64_t *)(file.data + sizeof(PolicyTableHeader));
+        slotMask = header->numSlots - 1;
+        return true;
+    }
+
+    bool isLoaded() const
+    {
+        return header != nullptr;
+    }
+
+    static uint64_t getSlotIndex(uint64_t hash, uint64_t mask)
+    {
+        return (hash >> 2) & mask;
+    }
+
+    // Returns false if the position is not in the table
+    bool getAction(uint64_t hash, SnakeActions &action) const
+    {
+        uint64_t index = getSlotIndex(hash, slotMask);
+        while (slots[index] != 0)
+        {
+            if ((slots[index] & keyMask) == (hash & keyMask))
+            {
+                action = (SnakeActions)(slots[index] & 3);
+                return true;
+            }
+            index = (index + 1) & slotMask;
+        }
+        return false;
+    }
+
+    // Used by the solver to fill a slot array before writing it
+    static void insert(std::vector<uint64_t> &tableSlots, uint64_t hash, SnakeActions action)
+    {
+        const uint64_t mask = tableSlots.size() - 1;
+        uint64_t index = getSlotIndex(hash, mask);
+        while (tableSlots[index] != 0)
+        {
+            index = (index + 1) & mask;
+        }
+        tableSlots[index] = (hash & keyMask) | (uint64_t)action;
+    }
+
+    static bool save(const std::string &path, int size, uint64_t numStates, double optimalScore, const std::vector<uint64_t> &tableSlots)
+    {
+        PolicyTableHeader fileHeader = {};
+        std::memcpy(fileHeader.magic, "SNAKEPOL", 8);
+        fileHeader.version = version;
+        fileHeader.size = size;
+        fileHeader.numSlots = tableSlots.size();
+        fileHeader.numStates = numStates;
+        fileHeader.optimalScore = optimalScore;
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+        file.write((const char *)&fileHeader, sizeof(fileHeader));
+        file.write((const char *)tableSlots.data(), tableSlots.size() * sizeof(uint64_t));
+        return (bool)file;
+    }
+};
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef QUANTIZED_MODEL_HPP
+#define QUANTIZED_MODEL_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "game.hpp"
+
+/*
+Int8 copy of a trained SnakeModel, for inference only.
+
+Every weight matrix is stored as int8 with one float scale per column (per hidden unit for weight0
+and weight1, per action for weight2), scale = max |column| / 127. The forward pass stays in
+integers where it can:
+- board @ weight0 is uint8 board values times int8 weights, int16 products summed in int32
+- the activation runs in float on the dequantized sums, its output in [-1, 1] is requantized to int8
+- hidden @ weight2 is int8 times int8, summed in int32, then scaled back to float logits
+
+The weights take a quarter of the float model's memory. Speed depends on the SIMD level and on whether
+the game loop keeps an accumulator. bench.cpp's benchQuantized, ns per call, minimum of 4 runs on one
+AVX-512 machine (single runs vary by about 10%):
+
+                        SSE2            AVX2            AVX-512
+                        float   int8    float   int8    float   int8
+    forward 4x4/32      76      78      64      69      52      65
+    forward 4x4/256     337     401     179     195     126     199
+    forward 8x8/1024    1360    1536    667     793     489     793
+    forward 16x16/1024  1424    1585    757     798     578     806
+    step 4x4/32         88      70      67      52      63      49
+    step 4x4/256        483     359     209     180     155     183
+    step 8x8/1024       2045    1324    812     597     614     610
+    step 16x16/1024     1619    1390    771     636     623     627
+
+A step is an accumulator move plus a forward from the accumulator, what a game loop pays per move.
+From the board the int8 forward is a little slower at SSE2 and AVX2 and clearly slower at AVX-512:
+widening int8 and the float round trip of the activation cost more than the smaller reads save, and
+the int8 kernels have no AVX-512 version. Stepped from a QuantizedHiddenAccumulator it is 1.1-1.5x
+faster than the float accumulator at SSE2 and AVX2. At AVX-512 it is only ahead at 4x4/32, behind at
+4x4/256 and even at hidden 1024, so it gives more inferences per core below AVX-512 only.
+measureQuantizationDrift reports how far the int8 outputs move the chosen actions.
+*/
+
+/*
+HiddenAccumulator for a QuantizedSnakeModel: board @ weight0 kept across game steps in the int32 units
+of the int8 forward pass, with the same move and grow updates. Integer sums are exact, so
+forward from it gives exactly the outputs of forward from the board.
+*/
+struct QuantizedHiddenAccumulator
+{
+    std::vector<int32_t> preActivation; // board @ weight0
+    std::vector<int32_t> occupiedSum;   // Sum of the weight0 rows of the cells under the snake
+
+    QuantizedHiddenAccumulator() {}
+
+    QuantizedHiddenAccumulator(int hiddenSize)
+        : preActivation(hiddenSize),
+          occupiedSum(hiddenSize)
+    {
+    }
+
+    void refresh(const std::vector<int8_t> &weight0, const uint8_t *board)
+    {
+        const int hiddenSize = (int)preActivation.size();
+        const int numCells = (int)weight0.size() / hiddenSize;
+        std::fill(preActivation.begin(), preActivation.end(), 0);
+        std::fill(occupiedSum.begin(), occupiedSum.end(), 0);
+        for (int i = 0; i < numCells; i++)
+        {
+            if (board[i] == 0)
+            {
+                continue;
+            }
+            const int8_t *row = &weight0[i * hiddenSize];
+            simdAddScaledInt8(preActivation.data(), row, board[i], hiddenSize);
+            simdAddScaledInt8(occupiedSum.data(), row, 1, hiddenSize);
+        }
+    }
+
+    // The tail left tailPosition and the head entered headPosition, length did not change
+    void move(const std::vector<int8_t> &weight0, int tailPosition, int headPosition, int length)
+    {
+        const int hiddenSize = (int)preActivation.size();
+        const int8_t *tailRow = &weight0[tailPosition * hiddenSize];
+        const int8_t *headRow = &weight0[headPosition * hiddenSize];
+        simdAccumulatorMoveInt8(preActivation.data(), occupiedSum.data(), headRow, tailRow, length, hiddenSize);
+    }
+
+    // The snake ate, the head entered headPosition and length is the new length
+    void grow(const std::vector<int8_t> &weight0, int headPosition, int length)
+    {
+        const int hiddenSize = (int)preActivation.size();
+        const int8_t *headRow = &weight0[headPosition * hiddenSize];
+        simdAddScaledInt8(preActivation.data(), headRow, length, hiddenSize);
+        simdAddScaledInt8(occupiedSum.data(), headRow, 1, hiddenSize);
+    }
+
+    // Catch up with a game that just stepped without dying, given its tail and length before the step
+    template <typename Game>
+    void update(const std::vector<int8_t> &weight0, const Game &game, int oldTailPosition, int oldLength)
+    {
+        if (game.bodyLength > oldLength)
+        {
+            grow(weight0, game.snakeHeadPosition, game.bodyLength);
+        }
+        else
+        {
+            move(weight0, oldTailPosition, game.snakeHeadPosition, game.bodyLength);
+        }
+    }
+};
+
+struct QuantizedSnakeModel
+{
+    int size = 0;
+    int hiddenSize = 0;
+
+    std::vector<int8_t> weight0;      // (size * size, hiddenSize)
+    std::vector<int8_t> weight1;      // (size * size, hiddenSize)
+    std::vector<int8_t> weight2;      // (3, hiddenSize), transposed so each action's column is contiguous
+    std::vector<float> hiddenScales;  // Per hidden unit, scale of its weight0 column times scale of its weight1 column
+    float scales2[3] = {};            // Per column of weight2, divided by the 127 hidden values are scaled by
+
+    // Scratch for forward
+    std::vector<int32_t> accumulator;
+    std::vector<int8_t> hidden;
+
+    QuantizedSnakeModel() {}
+
+    QuantizedSnakeModel(const SnakeModel &model)
+    {
+        quantize(model);
+    }
+
+    // Column-wise symmetric quantization of a (rows, cols) float matrix, stored transposed if asked
+    static void quantizeColumns(const Matrix &matrix, std::vector<int8_t> &quantized, float *scales, bool transpose = false)
+    {
+        quantized.resize(matrix.numValues);
+        for (int j = 0; j < matrix.cols; j++)
+        {
+            float maxAbs = 0.0f;
+            for (int i = 0; i < matrix.rows; i++)
+            {
+                maxAbs = std::max(maxAbs, std::fabs(matrix.values[i * matrix.cols + j]));
+            }
+            const float scale = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+            scales[j] = scale;
+            for (int i = 0; i < matrix.rows; i++)
+            {
+                const float q = std::round(matrix.values[i * matrix.cols + j] / scale);
+                const int index = transpose ? j * matrix.rows + i : i * matrix.cols + j;
+                quantized[index] = (int8_t)std::max(-127.0f, std::min(127.0f, q));
+            }
+        }
+    }
+
+    void quantize(const SnakeModel &model)
+    {
+        size = model.size;
+        hiddenSize = model.hiddenSize;
+        std::vector<float> scales0(hiddenSize);
+        std::vector<float> scales1(hiddenSize);
+        quantizeColumns(model.weight0, weight0, scales0.data());
+        quantizeColumns(model.weight1, weight1, scales1.data());
+        quantizeColumns(model.weight2, weight2, scales2, true);
+        hiddenScales.resize(hiddenSize);
+        for (int j = 0; j < hiddenSize; j++)
+        {
+            hiddenScales[j] = scales0[j] * scales1[j];
+        }
+        for (int c = 0; c < 3; c++)
+        {
+            scales2[c] /= 127.0f;
+        }
+        accumulator.resize(hiddenSize);
+        hidden.resize(hiddenSize);
+    }
+
+    size_t getNumBytes() const
+    {
+        return weight0.size() + weight1.size() + weight2.size() + (hiddenScales.size() + 3) * sizeof(float);
+    }
+
+    void forward(const uint8_t *board, const int applePos, Matrix &out)
+    {
+        // accumulator = board @ weight0, int16 products summed in int32
+        int32_t *acc = accumulator.data();
+        std::fill(accumulator.begin(), accumulator.end(), 0);
+        for (int i = 0; i < size * size; i++)
+        {
+            // Empty cells add nothing
+            if (board[i] != 0)
+            {
+                simdAddScaledInt8(acc, &weight0[i * hiddenSize], board[i], hiddenSize);
+            }
+        }
+
+        forwardHidden(acc, applePos, out);
+    }
+
+    // Same as forward, with board @ weight0 taken from an accumulator the game loop keeps up to date
+    void forward(const QuantizedHiddenAccumulator &quantizedAccumulator, const int applePos, Matrix &out)
+    {
+        forwardHidden(quantizedAccumulator.preActivation.data(), applePos, out);
+    }
+
+    // Rest of the forward pass from acc = board @ weight0
+    void forwardHidden(const int32_t *acc, const int applePos, Matrix &out)
+    {
+        // hidden = activation(acc * weight1[applePos]), dequantized, then requantized to int8
+        simdActivationInt8(acc, &weight1[applePos * hiddenSize], hiddenScales.data(), hidden.data(), hiddenSize);
+
+        // out = hidden @ weight2, back to float logits
+        int32_t sums[3];
+        simdDot3Int8(hidden.data(), weight2.data(), hiddenSize, sums);
+        for (int c = 0; c < 3; c++)
+        {
+            out.values[c] = (float)sums[c] * scales2[c];
+        }
+    }
+};
+
+struct QuantizationDrift
+{
+    int numPositions = 0;
+    float argmaxAgreement = 0.0f;   // Fraction of positions where both models rank the same action first
+    float sampleAgreement = 0.0f;   // Fraction where both models sample the same action from the same random number
+    float meanTotalVariation = 0.0f; // Mean total variation distance between the two action distributions
+    float maxTotalVariation = 0.0f;
+    float maxLogitError = 0.0f;
+};
+
+int getArgmaxAction(const Matrix &out)
+{
+    int best = 0;
+    for (int c = 1; c < 3; c++)
+    {
+        if (out.values[c] > out.values[best])
+        {
+            best = c;
+        }
+    }
+    return best;
+}
+
+// Compares the two models on numPositions positions from games the float model plays
+template <typename Game>
+QuantizationDrift measureQuantizationDrift(SnakeModel &model, QuantizedSnakeModel &quantizedModel, int numPositions, uint32_t randSeed)
+{
+    QuantizationDrift drift;
+    Game game = Game(model.size, randSeed);
+    Matrix floatOut = Matrix(1, 3);
+    Matrix quantizedOut = Matrix(1, 3);
+    int argmaxMatches = 0;
+    int sampleMatches = 0;
+    double totalVariation = 0.0;
+
+    for (int n = 0; n < numPositions; n++)
+    {
+        const uint8_t *board = game.getBoard();
+        model.forward(board, game.applePosition, floatOut);
+        quantizedModel.forward(board, game.applePosition, quantizedOut);
+
+        for (int c = 0; c < 3; c++)
+        {
+            drift.maxLogitError = std::max(drift.maxLogitError, std::fabs(floatOut.values[c] - quantizedOut.values[c]));
+        }
+        argmaxMatches += getArgmaxAction(floatOut) == getArgmaxAction(quantizedOut);
+
+        // sampleAction softmaxes in place, so the distributions can be compared after sampling
+        uint32_t floatSeed = randSeed;
+        uint32_t quantizedSeed = randSeed;
+        const SnakeActions action = sampleAction(floatOut, floatSeed);
+        sampleMatches += action == sampleAction(quantizedOut, quantizedSeed);
+        float variation = 0.0f;
+        for (int c = 0; c < 3; c++)
+        {
+            variation += 0.5f * std::fabs(floatOut.values[c] - quantizedOut.values[c]);
+        }
+        totalVariation += variation;
+        drift.maxTotalVariation = std::max(drift.maxTotalVariation, variation);
+
+        // Walk on with the float model's action
+        randSeed = floatSeed;
+        if (game.step(action, randSeed))
+        {
+            game.reset(randSeed);
+        }
+    }
+
+    drift.numPositions = numPositions;
+    drift.argmaxAgreement = (float)argmaxMatches / (float)numPositions;
+    drift.sampleAgreement = (float)sampleMatches / (float)numPositions;
+    drift.meanTotalVariation = (float)(totalVariation / (double)numPositions);
+    return drift;
+}
+
+#endif
@@ -1,4 +1,5 @@
 #ifndef RANDOM_HPP
+#define RANDOM_HPP
 
 #include <cstdint>
 #include <limits>
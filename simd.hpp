@@ -0,0 +1,1832 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "random.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SIMD_X86
+#endif
+
+/*
+Vector kernels for Matrix, SnakeModel and AdamOptimizer.
+
+Each kernel has a scalar version plus SSE2, AVX2 (with FMA) and AVX-512 versions. The widest
+level the CPU supports is picked once from CPUID, and every call switches on it, so one binary
+runs everywhere. setSimdLevel() can force a lower level, bench.cpp uses it to compare them.
+
+Buffers do not have to be aligned (Matrix storage is 64-byte aligned anyway, see memoryPool.hpp),
+and lengths do not have to be a multiple of the vector width, leftovers run through the scalar loop.
+
+The int8 kernels for QuantizedSnakeModel only have SSE2 and AVX2 versions, the AVX-512 level runs
+the AVX2 ones (every AVX-512 CPU has AVX2, and widening int8 to zmm needs AVX-512BW on top). They are
+bound by widening int8 and the float round trip of the activation rather than by vector width: a
+fused AVX-512BW forward kernel measured no faster than these.
+Batched action sampling and the normal generator have no SSE2 version, PCG_Hash needs 32-bit
+multiplies and per-lane shifts SSE2 does not have. Sampling one game draws its random number with
+the scalar randFloat, so that one does.
+*/
+
+enum SimdLevel
+{
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_AVX512
+};
+
+SimdLevel detectSimdLevel()
+{
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return SIMD_SSE2;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+SimdLevel &getSimdLevelStorage()
+{
+    static SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+SimdLevel getSimdLevel()
+{
+    return getSimdLevelStorage();
+}
+
+// Use a lower level than the CPU supports, levels above what it supports are ignored
+void setSimdLevel(SimdLevel level)
+{
+    static const SimdLevel supportedLevel = detectSimdLevel();
+    getSimdLevelStorage() = level < supportedLevel ? level : supportedLevel;
+}
+
+const char *getSimdLevelName(SimdLevel level)
+{
+    const char *names[] = {"scalar", "SSE2", "AVX2", "AVX-512"};
+    return names[level];
+}
+
+// Scalar kernels, also used for the leftovers of the vector kernels
+
+// dst += src * scale
+void simdAddScaledScalar(float *dst, const float *src, float scale, int start, int n)
+{
+    for (int i = start; i < n; i++)
+    {
+        dst[i] += src[i] * scale;
+    }
+}
+
+// dst = base + src * scale
+void simdAddScaledToScalar(float *dst, const float *base, const float *src, float scale, int start, int n)
+{
+    for (int i = start; i < n; i++)
+    {
+        dst[i] = base[i] + src[i] * scale;
+    }
+}
+
+void simdMulScalar(float *dst, float val, int start, int n)
+{
+    for (int i = start; i < n; i++)
+    {
+        dst[i] *= val;
+    }
+}
+
+// dst = val
+void simdFillScalar(float *dst, float val, int start, int n)
+{
+    for (int i = start; i < n; i++)
+    {
+        dst[i] = val;
+    }
+}
+
+float simdDiffSquaredScalar(const float *a, const float *b, int start, int n)
+{
+    float val = 0.0f;
+    for (int i = start; i < n; i++)
+    {
+        const float diff = a[i] - (b != nullptr ? b[i] : 0.0f);
+        val += diff * diff;
+    }
+    return val;
+}
+
+float simdDotScalar(const float *a, const float *b, int start, int n)
+{
+    float val = 0.0f;
+    for (int i = start; i < n; i++)
+    {
+        val += a[i] * b[i];
+    }
+    return val;
+}
+
+// hidden = rational activation of hidden * scale, clamped to [-1, 1]
+void simdActivationScalar(float *hidden, const float *scale, int start, int n)
+{
+    for (int j = start; j < n; j++)
+    {
+        const float x = hidden[j] * scale[j];
+        if (x < -1.0f)
+        {
+            hidden[j] = -1.0f;
+        }
+        else if (x > 1.0f)
+        {
+            hidden[j] = 1.0f;
+        }
+        else
+        {
+            hidden[j] = (x + x) / (x * x + 1.0f);
+        }
+    }
+}
+
+// out[c] += sum over rows of hidden[i] * weights[i * 3 + c]
+void simdMatVec3Scalar(const float *hidden, const float *weights, int start, int n, float *out)
+{
+    for (int i = start; i < n; i++)
+    {
+        out[0] += hidden[i] * weights[i * 3 + 0];
+        out[1] += hidden[i] * weights[i * 3 + 1];
+        out[2] += hidden[i] * weights[i * 3 + 2];
+    }
+}
+
+// Rounds to nearest, ties to even like cvtps2dq, for |x| < 2^22. Adding and removing 1.5 * 2^23 drops
+// the fraction in the current rounding mode, where std::lrint would be a libm call
+int simdRoundScalar(float x)
+{
+    const float magic = 12582912.0f;
+    return (int)((x + magic) - magic);
+}
+
+// dst += src * scale for int8 src and scale at most 255, products fit int16
+void simdAddScaledInt8Scalar(int32_t *dst, const int8_t *src, int scale, int start, int n)
+{
+    for (int i = start; i < n; i++)
+    {
+        dst[i] += (int16_t)(src[i] * scale);
+    }
+}
+
+// QuantizedHiddenAccumulator::move in one pass: preActivation += length * head - occupiedSum, then
+// occupiedSum += head - tail, for int8 weight0 rows head and tail
+void simdAccumulatorMoveInt8Scalar(int32_t *preActivation, int32_t *occupiedSum, const int8_t *head, const int8_t *tail, int length, int start, int n)
+{
+    for (int i = start; i < n; i++)
+    {
+        preActivation[i] += head[i] * length - occupiedSum[i];
+        occupiedSum[i] += head[i] - tail[i];
+    }
+}
+
+// hidden = round(127 * activation(acc * apple * scales)), the activation's [-1, 1] output as int8
+void simdActivationInt8Scalar(const int32_t *acc, const int8_t *apple, const float *scales, int8_t *hidden, int start, int n)
+{
+    for (int i = start; i < n; i++)
+    {
+        float x = (float)acc[i] * (float)apple[i] * scales[i];
+        x = x < -1.0f ? -1.0f : (x > 1.0f ? 1.0f : x);
+        hidden[i] = (int8_t)simdRoundScalar((x + x) / (x * x + 1.0f) * 127.0f);
+    }
+}
+
+// sums[c] += x . columns[c * n ...] over int8 vectors, int16 products summed in int32
+void simdDot3Int8Scalar(const int8_t *x, const int8_t *columns, int start, int n, int32_t *sums)
+{
+    for (int i = start; i < n; i++)
+    {
+        sums[0] += (int16_t)(x[i] * columns[i]);
+        sums[1] += (int16_t)(x[i] * columns[n + i]);
+        sums[2] += (int16_t)(x[i] * columns[2 * n + i]);
+    }
+}
+
+/*
+Draws an action from the 3 logits at logits[i * 3] for every game i with active[i] != 0 (all of them
+if active is nullptr), with the game's seed stepped exactly like randFloat. Same distribution and same
+random number as sampleAction's softmax, but the probabilities are never normalized: with
+e = exp(logits - max) the action is the first c with u * (e0 + e1 + e2) < e0 + ... + ec.
+The vector versions take exp from a polynomial instead of std::exp, so they can only pick a different
+action than this one when u lands within about 1e-7 of a threshold.
+*/
+void simdSampleActionsScalar(const float *logits, uint32_t *randSeeds, const uint8_t *active, int start, int n, int32_t *actions)
+{
+    for (int i = start; i < n; i++)
+    {
+        if (active != nullptr && active[i] == 0)
+        {
+            continue;
+        }
+        const float *l = &logits[i * 3];
+        const float maxLogit = std::max(l[0], std::max(l[1], l[2]));
+        const float e0 = std::exp(l[0] - maxLogit);
+        const float e01 = e0 + std::exp(l[1] - maxLogit);
+        const float total = e01 + std::exp(l[2] - maxLogit);
+        const float val = randFloat(randSeeds[i]) * total;
+        actions[i] = val < e0 ? 0 : (val < e01 ? 1 : 2);
+    }
+}
+
+/*
+Counter-based normal generator, an alternative to randDist for filling whole buffers.
+
+Values 2k and 2k + 1 are one Box-Muller pair drawn from u1 = PCG_Hash(key + 2k) and
+u2 = PCG_Hash(key + 2k + 1), so every pair is independent of the others and lanes can draw them
+side by side. log, sin and cos are Cephes polynomials evaluated with the same operations in every
+version, and this block is compiled without FMA contraction, so the output is bit-identical at every
+SIMD level. u1 has 24 bits, which caps |value| at 5.77 std.
+*/
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+
+// log(x) for x in (0, 1]
+float simdLogScalar(float x)
+{
+    int32_t bits;
+    std::memcpy(&bits, &x, 4);
+    float e = (float)((bits >> 23) - 126);
+    bits = (bits & 0x007FFFFF) | 0x3F000000; // Mantissa in [0.5, 1)
+    float m;
+    std::memcpy(&m, &bits, 4);
+    if (m < 0.707106781f)
+    {
+        e = e - 1.0f;
+        m = m + m - 1.0f;
+    }
+    else
+    {
+        m = m - 1.0f;
+    }
+    const float z = m * m;
+    float y = 7.0376836292e-2f;
+    y = y * m - 1.1514610310e-1f;
+    y = y * m + 1.1676998740e-1f;
+    y = y * m - 1.2420140846e-1f;
+    y = y * m + 1.4249322787e-1f;
+    y = y * m - 1.6668057665e-1f;
+    y = y * m + 2.0000714765e-1f;
+    y = y * m - 2.4999993993e-1f;
+    y = y * m + 3.3333331174e-1f;
+    y = y * m * z;
+    y = y - 2.12194440e-4f * e;
+    y = y - 0.5f * z;
+    return m + y + 0.693359375f * e;
+}
+
+// values[0] = std * r * cos(theta), values[1] = std * r * sin(theta) for pair number pair
+void simdNormalPairScalar(uint32_t key, uint32_t pair, float std, float *values)
+{
+    const uint32_t h1 = PCG_Hash(key + 2 * pair);
+    const uint32_t h2 = PCG_Hash(key + 2 * pair + 1);
+    const float u1 = (float)((h1 >> 8) + 1) * (1.0f / 16777216.0f); // (0, 1]
+    const float u2 = (float)(h2 >> 8) * (1.0f / 16777216.0f);       // [0, 1)
+    const float radius = std::sqrt(-2.0f * simdLogScalar(u1)) * std;
+
+    // theta = 2 pi u2 = quadrant * pi / 2 + x with x in [-pi / 4, pi / 4]
+    const int quadrant = simdRoundScalar(4.0f * u2);
+    const float x = (u2 - 0.25f * (float)quadrant) * 6.28318530718f;
+    const float z = x * x;
+    float sinX = -1.9515295891e-4f;
+    sinX = sinX * z + 8.3321608736e-3f;
+    sinX = sinX * z - 1.6666654611e-1f;
+    sinX = sinX * z * x + x;
+    float cosX = 2.443315711809948e-5f;
+    cosX = cosX * z - 1.388731625493765e-3f;
+    cosX = cosX * z + 4.166664568298827e-2f;
+    cosX = cosX * z * z - 0.5f * z + 1.0f;
+
+    // Rotate by the quadrant: (cos, sin), (-sin, cos), (-cos, -sin), (sin, -cos)
+    float cosTheta = (quadrant & 1) ? sinX : cosX;
+    float sinTheta = (quadrant & 1) ? cosX : sinX;
+    cosTheta = ((quadrant + 1) & 2) ? -cosTheta : cosTheta;
+    sinTheta = (quadrant & 2) ? -sinTheta : sinTheta;
+    values[0] = radius * cosTheta;
+    values[1] = radius * sinTheta;
+}
+
+// dst[i] = (or += when add) value i of the stream for key, for i in [start, n)
+void simdNormalsScalar(float *dst, uint32_t key, float std, bool add, int start, int n)
+{
+    float values[2];
+    for (int i = start; i < n; i++)
+    {
+        if (i == start || (i & 1) == 0)
+        {
+            simdNormalPairScalar(key, (uint32_t)i >> 1, std, values);
+        }
+        dst[i] = add ? dst[i] + values[i & 1] : values[i & 1];
+    }
+}
+
+#pragma GCC pop_options
+
+// out = activation(preActivation * scale) @ weight2 for (n, 3) weight2, the activation never stored
+void simdForwardHiddenScalar(const float *preActivation, const float *scale, const float *weight2, int start, int n, float *out)
+{
+    for (int j = start; j < n; j++)
+    {
+        const float x = preActivation[j] * scale[j];
+        const float y = x < -1.0f ? -1.0f : (x > 1.0f ? 1.0f : (x + x) / (x * x + 1.0f));
+        out[0] += y * weight2[j * 3 + 0];
+        out[1] += y * weight2[j * 3 + 1];
+        out[2] += y * weight2[j * 3 + 2];
+    }
+}
+
+struct AdamConstants
+{
+    float beta1;
+    float beta2;
+    float beta1Minus;
+    float beta2Minus;
+    float mHatMul;
+    float vHatMul;
+    float alpha;
+    float eps;
+};
+
+void simdAdamScalar(float *m, float *v, float *grad, const AdamConstants &c, int start, int n)
+{
+    for (int i = start; i < n; i++)
+    {
+        const float mVal = c.beta1 * m[i] + c.beta1Minus * grad[i];
+        m[i] = mVal;
+        const float vVal = c.beta2 * v[i] + c.beta2Minus * grad[i] * grad[i];
+        v[i] = vVal;
+        grad[i] = c.alpha * (mVal * c.mHatMul) / (sqrtf(vVal * c.vHatMul) + c.eps);
+    }
+}
+
+#ifdef SIMD_X86
+
+// SSE2, 4 floats at a time
+
+__attribute__((target("sse2"))) float simdHorizontalSumSSE2(__m128 x)
+{
+    float lanes[4];
+    _mm_storeu_ps(lanes, x);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+__attribute__((target("sse2"))) __m128 simdSelectSSE2(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+__attribute__((target("sse2"))) int simdAddScaledSSE2(float *dst, const float *src, float scale, int n)
+{
+    const __m128 scaleVec = _mm_set1_ps(scale);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(&dst[i], _mm_add_ps(_mm_loadu_ps(&dst[i]), _mm_mul_ps(_mm_loadu_ps(&src[i]), scaleVec)));
+    }
+    return i;
+}
+
+__attribute__((target("sse2"))) int simdAddScaledToSSE2(float *dst, const float *base, const float *src, float scale, int n)
+{
+    const __m128 scaleVec = _mm_set1_ps(scale);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(&dst[i], _mm_add_ps(_mm_loadu_ps(&base[i]), _mm_mul_ps(_mm_loadu_ps(&src[i]), scaleVec)));
+    }
+    return i;
+}
+
+__attribute__((target("sse2"))) int simdMulSSE2(float *dst, float val, int n)
+{
+    const __m128 valVec = _mm_set1_ps(val);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(&dst[i], _mm_mul_ps(_mm_loadu_ps(&dst[i]), valVec));
+    }
+    return i;
+}
+
+__attribute__((target("sse2"))) int simdFillSSE2(float *dst, float val, int n)
+{
+    const __m128 valVec = _mm_set1_ps(val);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(&dst[i], valVec);
+    }
+    return i;
+}
+
+__attribute__((target("sse2"))) int simdDiffSquaredSSE2(const float *a, const float *b, int n, float &sum)
+{
+    __m128 acc = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 diff = b != nullptr ? _mm_sub_ps(_mm_loadu_ps(&a[i]), _mm_loadu_ps(&b[i])) : _mm_loadu_ps(&a[i]);
+        acc = _mm_add_ps(acc, _mm_mul_ps(diff, diff));
+    }
+    sum = simdHorizontalSumSSE2(acc);
+    return i;
+}
+
+__attribute__((target("sse2"))) int simdDotSSE2(const float *a, const float *b, int n, float &sum)
+{
+    __m128 acc = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&a[i]), _mm_loadu_ps(&b[i])));
+    }
+    sum = simdHorizontalSumSSE2(acc);
+    return i;
+}
+
+__attribute__((target("sse2"))) int simdActivationSSE2(float *hidden, const float *scale, int n)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 x = _mm_mul_ps(_mm_loadu_ps(&hidden[i]), _mm_loadu_ps(&scale[i]));
+        const __m128 rational = _mm_div_ps(_mm_add_ps(x, x), _mm_add_ps(_mm_mul_ps(x, x), one));
+        const __m128 above = _mm_cmpgt_ps(x, one);
+        const __m128 below = _mm_cmplt_ps(x, minusOne);
+        __m128 y = _mm_or_ps(_mm_and_ps(above, one), _mm_andnot_ps(above, rational));
+        y = _mm_or_ps(_mm_and_ps(below, minusOne), _mm_andnot_ps(below, y));
+        _mm_storeu_ps(&hidden[i], y);
+    }
+    return i;
+}
+
+/*
+4 rows of the (n, 3) weights are 3 vectors: [a0 b0 c0 a1] [b1 c1 a2 b2] [c2 a3 b3 c3]
+Lane l of accumulator k sums column (l + k * width) % 3. Each lane holds a different column in
+each of the 3 accumulators, so blending one lane from each gives a vector of a single column.
+The AVX2 and AVX-512 versions work the same way with wider vectors.
+*/
+__attribute__((target("sse2"))) int simdMatVec3SSE2(const float *hidden, const float *weights, int n, float *out)
+{
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 h = _mm_loadu_ps(&hidden[i]);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(&weights[i * 3 + 0]), _mm_shuffle_ps(h, h, _MM_SHUFFLE(1, 0, 0, 0))));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(&weights[i * 3 + 4]), _mm_shuffle_ps(h, h, _MM_SHUFFLE(2, 2, 1, 1))));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(&weights[i * 3 + 8]), _mm_shuffle_ps(h, h, _MM_SHUFFLE(3, 3, 3, 2))));
+    }
+    const __m128 lanes0 = _mm_castsi128_ps(_mm_setr_epi32(-1, 0, 0, -1)); // Lanes where l % 3 == 0
+    const __m128 lanes1 = _mm_castsi128_ps(_mm_setr_epi32(0, -1, 0, 0));
+    const __m128 lanes2 = _mm_castsi128_ps(_mm_setr_epi32(0, 0, -1, 0));
+    out[0] += simdHorizontalSumSSE2(simdSelectSSE2(lanes0, acc0, simdSelectSSE2(lanes2, acc1, acc2)));
+    out[1] += simdHorizontalSumSSE2(simdSelectSSE2(lanes1, acc0, simdSelectSSE2(lanes0, acc1, acc2)));
+    out[2] += simdHorizontalSumSSE2(simdSelectSSE2(lanes2, acc0, simdSelectSSE2(lanes1, acc1, acc2)));
+    return i;
+}
+
+/*
+simdActivation and simdMatVec3 fused, the same steps in the same order so the output matches them
+exactly. Each block of hidden columns is scaled, activated and multiplied into weight2 without
+leaving registers. Returns the number of columns done, the rest are left for the scalar version.
+*/
+__attribute__((target("sse2"))) int simdForwardHiddenSSE2(const float *preActivation, const float *scale, const float *weight2, int n, float *out)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 x = _mm_mul_ps(_mm_loadu_ps(&preActivation[i]), _mm_loadu_ps(&scale[i]));
+        const __m128 rational = _mm_div_ps(_mm_add_ps(x, x), _mm_add_ps(_mm_mul_ps(x, x), one));
+        const __m128 above = _mm_cmpgt_ps(x, one);
+        const __m128 below = _mm_cmplt_ps(x, minusOne);
+        __m128 y = _mm_or_ps(_mm_and_ps(above, one), _mm_andnot_ps(above, rational));
+        y = _mm_or_ps(_mm_and_ps(below, minusOne), _mm_andnot_ps(below, y));
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(&weight2[i * 3]), _mm_shuffle_ps(y, y, _MM_SHUFFLE(1, 0, 0, 0))));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(&weight2[i * 3 + 4]), _mm_shuffle_ps(y, y, _MM_SHUFFLE(2, 2, 1, 1))));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(&weight2[i * 3 + 8]), _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 2))));
+    }
+    const __m128 lanes0 = _mm_castsi128_ps(_mm_setr_epi32(-1, 0, 0, -1));
+    const __m128 lanes1 = _mm_castsi128_ps(_mm_setr_epi32(0, -1, 0, 0));
+    const __m128 lanes2 = _mm_castsi128_ps(_mm_setr_epi32(0, 0, -1, 0));
+    out[0] += simdHorizontalSumSSE2(simdSelectSSE2(lanes0, acc0, simdSelectSSE2(lanes2, acc1, acc2)));
+    out[1] += simdHorizontalSumSSE2(simdSelectSSE2(lanes1, acc0, simdSelectSSE2(lanes0, acc1, acc2)));
+    out[2] += simdHorizontalSumSSE2(simdSelectSSE2(lanes2, acc0, simdSelectSSE2(lanes1, acc1, acc2)));
+    return i;
+}
+
+__attribute__((target("sse2"))) int simdAdamSSE2(float *m, float *v, float *grad, const AdamConstants &c, int n)
+{
+    const __m128 beta1 = _mm_set1_ps(c.beta1);
+    const __m128 beta2 = _mm_set1_ps(c.beta2);
+    const __m128 beta1Minus = _mm_set1_ps(c.beta1Minus);
+    const __m128 beta2Minus = _mm_set1_ps(c.beta2Minus);
+    const __m128 mHatMul = _mm_set1_ps(c.mHatMul);
+    const __m128 vHatMul = _mm_set1_ps(c.vHatMul);
+    const __m128 alpha = _mm_set1_ps(c.alpha);
+    const __m128 eps = _mm_set1_ps(c.eps);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 g = _mm_loadu_ps(&grad[i]);
+        const __m128 mVal = _mm_add_ps(_mm_mul_ps(beta1, _mm_loadu_ps(&m[i])), _mm_mul_ps(beta1Minus, g));
+        const __m128 vVal = _mm_add_ps(_mm_mul_ps(beta2, _mm_loadu_ps(&v[i])), _mm_mul_ps(_mm_mul_ps(beta2Minus, g), g));
+        _mm_storeu_ps(&m[i], mVal);
+        _mm_storeu_ps(&v[i], vVal);
+        const __m128 denominator = _mm_add_ps(_mm_sqrt_ps(_mm_mul_ps(vVal, vHatMul)), eps);
+        _mm_storeu_ps(&grad[i], _mm_div_ps(_mm_mul_ps(alpha, _mm_mul_ps(mVal, mHatMul)), denominator));
+    }
+    return i;
+}
+
+// Sign-extends the low or high 8 int8 of x to int16
+__attribute__((target("sse2"))) __m128i simdWidenLowInt8SSE2(__m128i x)
+{
+    return _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+}
+
+__attribute__((target("sse2"))) __m128i simdWidenHighInt8SSE2(__m128i x)
+{
+    return _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8);
+}
+
+__attribute__((target("sse2"))) void simdAddInt16SSE2(int32_t *dst, __m128i x)
+{
+    const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+    _mm_storeu_si128((__m128i *)dst, _mm_add_epi32(_mm_loadu_si128((const __m128i *)dst), low));
+    _mm_storeu_si128((__m128i *)&dst[4], _mm_add_epi32(_mm_loadu_si128((const __m128i *)&dst[4]), high));
+}
+
+__attribute__((target("sse2"))) int simdAddScaledInt8SSE2(int32_t *dst, const int8_t *src, int scale, int n)
+{
+    const __m128i s = _mm_set1_epi16((int16_t)scale);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i *)&src[i]);
+        simdAddInt16SSE2(&dst[i], _mm_mullo_epi16(simdWidenLowInt8SSE2(x), s));
+        simdAddInt16SSE2(&dst[i + 8], _mm_mullo_epi16(simdWidenHighInt8SSE2(x), s));
+    }
+    return i;
+}
+
+// SSE2 has no 32-bit multiply, head * length fits int16 for length at most 255
+__attribute__((target("sse2"))) int simdAccumulatorMoveInt8SSE2(int32_t *preActivation, int32_t *occupiedSum, const int8_t *head, const int8_t *tail, int length, int n)
+{
+    const __m128i len = _mm_set1_epi16((int16_t)length);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i h = simdWidenLowInt8SSE2(_mm_loadl_epi64((const __m128i *)&head[i]));
+        const __m128i t = simdWidenLowInt8SSE2(_mm_loadl_epi64((const __m128i *)&tail[i]));
+        for (int j = i; j < i + 8; j += 4)
+        {
+            const __m128i pre = _mm_loadu_si128((const __m128i *)&preActivation[j]);
+            _mm_storeu_si128((__m128i *)&preActivation[j], _mm_sub_epi32(pre, _mm_loadu_si128((const __m128i *)&occupiedSum[j])));
+        }
+        simdAddInt16SSE2(&preActivation[i], _mm_mullo_epi16(h, len));
+        simdAddInt16SSE2(&occupiedSum[i], _mm_sub_epi16(h, t));
+    }
+    return i;
+}
+
+__attribute__((target("sse2"))) int simdActivationInt8SSE2(const int32_t *acc, const int8_t *apple, const float *scales, int8_t *hidden, int n)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    const __m128 outScale = _mm_set1_ps(127.0f);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        int32_t appleBytes;
+        std::memcpy(&appleBytes, &apple[i], 4);
+        const __m128i apple16 = simdWidenLowInt8SSE2(_mm_cvtsi32_si128(appleBytes));
+        const __m128 appleValues = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(apple16, apple16), 16));
+        __m128 x = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)&acc[i])), appleValues), _mm_loadu_ps(&scales[i]));
+        x = _mm_min_ps(_mm_max_ps(x, minusOne), one);
+        const __m128 y = _mm_div_ps(_mm_add_ps(x, x), _mm_add_ps(_mm_mul_ps(x, x), one));
+        const __m128i q = _mm_cvtps_epi32(_mm_mul_ps(y, outScale));
+        const __m128i packed = _mm_packs_epi16(_mm_packs_epi32(q, q), q);
+        const int32_t hiddenBytes = _mm_cvtsi128_si32(packed);
+        std::memcpy(&hidden[i], &hiddenBytes, 4);
+    }
+    return i;
+}
+
+__attribute__((target("sse2"))) int simdDot3Int8SSE2(const int8_t *x, const int8_t *columns, int n, int32_t *sums)
+{
+    __m128i acc[3] = {_mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()};
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i xs = _mm_loadu_si128((const __m128i *)&x[i]);
+        const __m128i low = simdWidenLowInt8SSE2(xs);
+        const __m128i high = simdWidenHighInt8SSE2(xs);
+        for (int c = 0; c < 3; c++)
+        {
+            const __m128i w = _mm_loadu_si128((const __m128i *)&columns[c * n + i]);
+            acc[c] = _mm_add_epi32(acc[c], _mm_madd_epi16(low, simdWidenLowInt8SSE2(w)));
+            acc[c] = _mm_add_epi32(acc[c], _mm_madd_epi16(high, simdWidenHighInt8SSE2(w)));
+        }
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        int32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, acc[c]);
+        sums[c] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return i;
+}
+
+// e^x for x <= 0, simdExpAVX2's polynomial with its terms summed in pairs instead of one chain, which
+// shortens the dependency chain for the single vector simdSampleActionSSE2 runs through it
+__attribute__((target("sse2"))) __m128 simdExpSSE2(__m128 x)
+{
+    x = _mm_max_ps(x, _mm_set1_ps(-87.0f));
+    // Adding 1.5 * 2^23 rounds x / log(2) to the integer left in the low mantissa bits
+    const __m128 shifted = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504f)), _mm_set1_ps(12582912.0f));
+    const __m128 fn = _mm_sub_ps(shifted, _mm_set1_ps(12582912.0f));
+    const __m128 r = _mm_add_ps(_mm_sub_ps(x, _mm_mul_ps(fn, _mm_set1_ps(0.693359375f))), _mm_mul_ps(fn, _mm_set1_ps(2.12194440e-4f)));
+    const __m128 r2 = _mm_mul_ps(r, r);
+    const __m128 p01 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(1.6666665459e-1f), r), _mm_set1_ps(5.0000001201e-1f));
+    const __m128 p23 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(8.3334519073e-3f), r), _mm_set1_ps(4.1665795894e-2f));
+    const __m128 p45 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(1.9875691500e-4f), r), _mm_set1_ps(1.3981999507e-3f));
+    const __m128 p = _mm_add_ps(_mm_add_ps(p01, _mm_mul_ps(p23, r2)), _mm_mul_ps(p45, _mm_mul_ps(r2, r2)));
+    const __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p, r2), r), _mm_set1_ps(1.0f));
+    const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_castps_si128(shifted), _mm_set1_epi32(127 - 0x4B400000)), 23));
+    return _mm_mul_ps(y, scale);
+}
+
+// Action from the exps of a game's 3 logits (lanes 0 to 2): the number of running sums u * total is not under
+__attribute__((target("sse2"))) int32_t simdPickActionSSE2(__m128 e, float u)
+{
+    const __m128 sums = _mm_add_ps(_mm_add_ps(e, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(e), 4))), _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(e), 8)));
+    const __m128 val = _mm_mul_ps(_mm_set1_ps(u), _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(2, 2, 2, 2)));
+    const int below = _mm_movemask_ps(_mm_cmplt_ps(val, sums));
+    return 2 - (below & 1) - ((below >> 1) & 1);
+}
+
+// One game of simdSampleActionsScalar with the 3 exps as one vector and no branch on the action
+__attribute__((target("sse2"))) int32_t simdSampleActionSSE2(const float *logits, uint32_t &randSeed)
+{
+    const float maxLogit = std::max(logits[0], std::max(logits[1], logits[2]));
+    const __m128 x = _mm_sub_ps(_mm_setr_ps(logits[0], logits[1], logits[2], maxLogit), _mm_set1_ps(maxLogit));
+    return simdPickActionSSE2(simdExpSSE2(x), randFloat(randSeed));
+}
+
+// AVX2 + FMA, 8 floats at a time
+
+__attribute__((target("avx2,fma"))) int simdAddScaledAVX2(float *dst, const float *src, float scale, int n)
+{
+    const __m256 scaleVec = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(&dst[i], _mm256_fmadd_ps(_mm256_loadu_ps(&src[i]), scaleVec, _mm256_loadu_ps(&dst[i])));
+    }
+    return i;
+}
+
+__attribute__((target("avx2,fma"))) int simdAddScaledToAVX2(float *dst, const float *base, const float *src, float scale, int n)
+{
+    const __m256 scaleVec = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(&dst[i], _mm256_fmadd_ps(_mm256_loadu_ps(&src[i]), scaleVec, _mm256_loadu_ps(&base[i])));
+    }
+    return i;
+}
+
+__attribute__((target("avx2,fma"))) int simdMulAVX2(float *dst, float val, int n)
+{
+    const __m256 valVec = _mm256_set1_ps(val);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(&dst[i], _mm256_mul_ps(_mm256_loadu_ps(&dst[i]), valVec));
+    }
+    return i;
+}
+
+__attribute__((target("avx2,fma"))) int simdFillAVX2(float *dst, float val, int n)
+{
+    const __m256 valVec = _mm256_set1_ps(val);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(&dst[i], valVec);
+    }
+    return i;
+}
+
+__attribute__((target("avx2,fma"))) float simdHorizontalSumAVX2(__m256 x)
+{
+    return simdHorizontalSumSSE2(_mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1)));
+}
+
+__attribute__((target("avx2,fma"))) int simdDiffSquaredAVX2(const float *a, const float *b, int n, float &sum)
+{
+    __m256 acc = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 diff = b != nullptr ? _mm256_sub_ps(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i])) : _mm256_loadu_ps(&a[i]);
+        acc = _mm256_fmadd_ps(diff, diff, acc);
+    }
+    sum = simdHorizontalSumAVX2(acc);
+    return i;
+}
+
+__attribute__((target("avx2,fma"))) int simdDotAVX2(const float *a, const float *b, int n, float &sum)
+{
+    __m256 acc = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i]), acc);
+    }
+    sum = simdHorizontalSumAVX2(acc);
+    return i;
+}
+
+__attribute__((target("avx2,fma"))) int simdActivationAVX2(float *hidden, const float *scale, int n)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 minusOne = _mm256_set1_ps(-1.0f);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 x = _mm256_mul_ps(_mm256_loadu_ps(&hidden[i]), _mm256_loadu_ps(&scale[i]));
+        const __m256 rational = _mm256_div_ps(_mm256_add_ps(x, x), _mm256_fmadd_ps(x, x, one));
+        __m256 y = _mm256_blendv_ps(rational, one, _mm256_cmp_ps(x, one, _CMP_GT_OQ));
+        y = _mm256_blendv_ps(y, minusOne, _mm256_cmp_ps(x, minusOne, _CMP_LT_OQ));
+        _mm256_storeu_ps(&hidden[i], y);
+    }
+    return i;
+}
+
+// 8 rows of the (n, 3) weights are 3 vectors, each hidden value is repeated over its 3 columns with a permute
+__attribute__((target("avx2,fma"))) int simdMatVec3AVX2(const float *hidden, const float *weights, int n, float *out)
+{
+    const __m256i rows0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+    const __m256i rows1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+    const __m256i rows2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 h = _mm256_loadu_ps(&hidden[i]);
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(&weights[i * 3 + 0]), _mm256_permutevar8x32_ps(h, rows0), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(&weights[i * 3 + 8]), _mm256_permutevar8x32_ps(h, rows1), acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(&weights[i * 3 + 16]), _mm256_permutevar8x32_ps(h, rows2), acc2);
+    }
+    // Blend masks of the lanes where l % 3 is 0, 1 and 2: 0x49, 0x92 and 0x24
+    out[0] += simdHorizontalSumAVX2(_mm256_blend_ps(_mm256_blend_ps(acc2, acc1, 0x92), acc0, 0x49));
+    out[1] += simdHorizontalSumAVX2(_mm256_blend_ps(_mm256_blend_ps(acc2, acc1, 0x24), acc0, 0x92));
+    out[2] += simdHorizontalSumAVX2(_mm256_blend_ps(_mm256_blend_ps(acc2, acc1, 0x49), acc0, 0x24));
+    return i;
+}
+
+__attribute__((target("avx2,fma"))) int simdForwardHiddenAVX2(const float *preActivation, const float *scale, const float *weight2, int n, float *out)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 minusOne = _mm256_set1_ps(-1.0f);
+    const __m256i rows0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+    const __m256i rows1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+    const __m256i rows2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 x = _mm256_mul_ps(_mm256_loadu_ps(&preActivation[i]), _mm256_loadu_ps(&scale[i]));
+        const __m256 rational = _mm256_div_ps(_mm256_add_ps(x, x), _mm256_fmadd_ps(x, x, one));
+        __m256 y = _mm256_blendv_ps(rational, one, _mm256_cmp_ps(x, one, _CMP_GT_OQ));
+        y = _mm256_blendv_ps(y, minusOne, _mm256_cmp_ps(x, minusOne, _CMP_LT_OQ));
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(&weight2[i * 3]), _mm256_permutevar8x32_ps(y, rows0), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(&weight2[i * 3 + 8]), _mm256_permutevar8x32_ps(y, rows1), acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(&weight2[i * 3 + 16]), _mm256_permutevar8x32_ps(y, rows2), acc2);
+    }
+    out[0] += simdHorizontalSumAVX2(_mm256_blend_ps(_mm256_blend_ps(acc2, acc1, 0x92), acc0, 0x49));
+    out[1] += simdHorizontalSumAVX2(_mm256_blend_ps(_mm256_blend_ps(acc2, acc1, 0x24), acc0, 0x92));
+    out[2] += simdHorizontalSumAVX2(_mm256_blend_ps(_mm256_blend_ps(acc2, acc1, 0x49), acc0, 0x24));
+    return i;
+}
+
+__attribute__((target("avx2,fma"))) int simdAdamAVX2(float *m, float *v, float *grad, const AdamConstants &c, int n)
+{
+    const __m256 beta1 = _mm256_set1_ps(c.beta1);
+    const __m256 beta2 = _mm256_set1_ps(c.beta2);
+    const __m256 beta1Minus = _mm256_set1_ps(c.beta1Minus);
+    const __m256 beta2Minus = _mm256_set1_ps(c.beta2Minus);
+    const __m256 mHatMul = _mm256_set1_ps(c.mHatMul);
+    const __m256 vHatMul = _mm256_set1_ps(c.vHatMul);
+    const __m256 alpha = _mm256_set1_ps(c.alpha);
+    const __m256 eps = _mm256_set1_ps(c.eps);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 g = _mm256_loadu_ps(&grad[i]);
+        const __m256 mVal = _mm256_fmadd_ps(beta1, _mm256_loadu_ps(&m[i]), _mm256_mul_ps(beta1Minus, g));
+        const __m256 vVal = _mm256_fmadd_ps(beta2, _mm256_loadu_ps(&v[i]), _mm256_mul_ps(_mm256_mul_ps(beta2Minus, g), g));
+        _mm256_storeu_ps(&m[i], mVal);
+        _mm256_storeu_ps(&v[i], vVal);
+        const __m256 denominator = _mm256_add_ps(_mm256_sqrt_ps(_mm256_mul_ps(vVal, vHatMul)), eps);
+        _mm256_storeu_ps(&grad[i], _mm256_div_ps(_mm256_mul_ps(alpha, _mm256_mul_ps(mVal, mHatMul)), denominator));
+    }
+    return i;
+}
+
+__attribute__((target("avx2,fma"))) int simdAddScaledInt8AVX2(int32_t *dst, const int8_t *src, int scale, int n)
+{
+    const __m256i s = _mm256_set1_epi16((int16_t)scale);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m256i products = _mm256_mullo_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)&src[i])), s);
+        const __m256i low = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(products));
+        const __m256i high = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(products, 1));
+        _mm256_storeu_si256((__m256i *)&dst[i], _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)&dst[i]), low));
+        _mm256_storeu_si256((__m256i *)&dst[i + 8], _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)&dst[i + 8]), high));
+    }
+    return i;
+}
+
+__attribute__((target("avx2,fma"))) int simdAccumulatorMoveInt8AVX2(int32_t *preActivation, int32_t *occupiedSum, const int8_t *head, const int8_t *tail, int length, int n)
+{
+    const __m256i len = _mm256_set1_epi32(length);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256i h = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)&head[i]));
+        const __m256i t = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)&tail[i]));
+        const __m256i o = _mm256_loadu_si256((const __m256i *)&occupiedSum[i]);
+        const __m256i pre = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)&preActivation[i]), _mm256_mullo_epi32(h, len));
+        _mm256_storeu_si256((__m256i *)&preActivation[i], _mm256_sub_epi32(pre, o));
+        _mm256_storeu_si256((__m256i *)&occupiedSum[i], _mm256_add_epi32(o, _mm256_sub_epi32(h, t)));
+    }
+    return i;
+}
+
+__attribute__((target("avx2,fma"))) int simdActivationInt8AVX2(const int32_t *acc, const int8_t *apple, const float *scales, int8_t *hidden, int n)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 minusOne = _mm256_set1_ps(-1.0f);
+    const __m256 outScale = _mm256_set1_ps(127.0f);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 appleValues = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)&apple[i])));
+        __m256 x = _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)&acc[i])), appleValues), _mm256_loadu_ps(&scales[i]));
+        x = _mm256_min_ps(_mm256_max_ps(x, minusOne), one);
+        const __m256 y = _mm256_div_ps(_mm256_add_ps(x, x), _mm256_add_ps(_mm256_mul_ps(x, x), one));
+        const __m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(y, outScale));
+        const __m128i q16 = _mm_packs_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+        _mm_storel_epi64((__m128i *)&hidden[i], _mm_packs_epi16(q16, q16));
+    }
+    return i;
+}
+
+__attribute__((target("avx2,fma"))) int simdDot3Int8AVX2(const int8_t *x, const int8_t *columns, int n, int32_t *sums)
+{
+    __m256i acc[3] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m256i xs = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)&x[i]));
+        for (int c = 0; c < 3; c++)
+        {
+            const __m256i w = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)&columns[c * n + i]));
+            acc[c] = _mm256_add_epi32(acc[c], _mm256_madd_epi16(xs, w));
+        }
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        const __m128i halves = _mm_add_epi32(_mm256_castsi256_si128(acc[c]), _mm256_extracti128_si256(acc[c], 1));
+        int32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, halves);
+        sums[c] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return i;
+}
+
+// e^x for x <= 0 (anything below -87 gives about e^-87), Cephes' expf polynomial, relative error around 1e-7
+__attribute__((target("avx2,fma"))) __m256 simdExpAVX2(__m256 x)
+{
+    x = _mm256_max_ps(x, _mm256_set1_ps(-87.0f));
+    const __m256i n = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504f)));
+    const __m256 fn = _mm256_cvtepi32_ps(n);
+    const __m256 r = _mm256_fmadd_ps(fn, _mm256_set1_ps(2.12194440e-4f), _mm256_fnmadd_ps(fn, _mm256_set1_ps(0.693359375f), x));
+    __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+    const __m256 y = _mm256_add_ps(_mm256_fmadd_ps(_mm256_mul_ps(p, r), r, r), _mm256_set1_ps(1.0f));
+    const __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23));
+    return _mm256_mul_ps(y, scale);
+}
+
+// PCG_Hash of 8 inputs at once
+__attribute__((target("avx2,fma"))) __m256i simdPCGHashAVX2(__m256i input)
+{
+    const __m256i state = _mm256_add_epi32(_mm256_mullo_epi32(input, _mm256_set1_epi32((int)747796405u)), _mm256_set1_epi32((int)2891336453u));
+    const __m256i shift = _mm256_add_epi32(_mm256_srli_epi32(state, 28), _mm256_set1_epi32(4));
+    const __m256i word = _mm256_mullo_epi32(_mm256_xor_si256(_mm256_srlv_epi32(state, shift), state), _mm256_set1_epi32(277803737));
+    return _mm256_xor_si256(_mm256_srli_epi32(word, 22), word);
+}
+
+// randFloat for 8 seeds at once, seeds are stepped in place
+__attribute__((target("avx2,fma"))) __m256 simdRandFloatAVX2(__m256i &seeds)
+{
+    seeds = simdPCGHashAVX2(seeds);
+    // Unsigned to float in two exact halves, so the sum is rounded once like (float)seed
+    const __m256 high = _mm256_cvtepi32_ps(_mm256_srli_epi32(seeds, 16));
+    const __m256 low = _mm256_cvtepi32_ps(_mm256_and_si256(seeds, _mm256_set1_epi32(0xFFFF)));
+    return _mm256_mul_ps(_mm256_fmadd_ps(high, _mm256_set1_ps(65536.0f), low), _mm256_set1_ps(1.0f / 4294967296.0f));
+}
+
+__attribute__((target("avx2,fma"))) int simdSampleActionsAVX2(const float *logits, uint32_t *randSeeds, const uint8_t *active, int n, int32_t *actions)
+{
+    const __m256i offsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 l0 = _mm256_i32gather_ps(&logits[i * 3], offsets, 4);
+        const __m256 l1 = _mm256_i32gather_ps(&logits[i * 3 + 1], offsets, 4);
+        const __m256 l2 = _mm256_i32gather_ps(&logits[i * 3 + 2], offsets, 4);
+        const __m256 maxLogit = _mm256_max_ps(l0, _mm256_max_ps(l1, l2));
+        const __m256 e0 = simdExpAVX2(_mm256_sub_ps(l0, maxLogit));
+        const __m256 e01 = _mm256_add_ps(e0, simdExpAVX2(_mm256_sub_ps(l1, maxLogit)));
+        const __m256 total = _mm256_add_ps(e01, simdExpAVX2(_mm256_sub_ps(l2, maxLogit)));
+
+        const __m256i oldSeeds = _mm256_loadu_si256((const __m256i *)&randSeeds[i]);
+        __m256i seeds = oldSeeds;
+        const __m256 val = _mm256_mul_ps(simdRandFloatAVX2(seeds), total);
+
+        // 2 plus -1 for each threshold val is under
+        const __m256i below0 = _mm256_castps_si256(_mm256_cmp_ps(val, e0, _CMP_LT_OQ));
+        const __m256i below01 = _mm256_castps_si256(_mm256_cmp_ps(val, e01, _CMP_LT_OQ));
+        __m256i action = _mm256_add_epi32(_mm256_set1_epi32(2), _mm256_add_epi32(below0, below01));
+
+        if (active != nullptr)
+        {
+            const __m256i isActive = _mm256_cmpgt_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&active[i])), _mm256_setzero_si256());
+            seeds = _mm256_blendv_epi8(oldSeeds, seeds, isActive);
+            action = _mm256_blendv_epi8(_mm256_loadu_si256((const __m256i *)&actions[i]), action, isActive);
+        }
+        _mm256_storeu_si256((__m256i *)&randSeeds[i], seeds);
+        _mm256_storeu_si256((__m256i *)&actions[i], action);
+    }
+    return i;
+}
+
+// simdSampleActionSSE2 with the polynomial in FMAs
+__attribute__((target("avx2,fma"))) int32_t simdSampleActionAVX2(const float *logits, uint32_t &randSeed)
+{
+    const float maxLogit = std::max(logits[0], std::max(logits[1], logits[2]));
+    __m128 x = _mm_sub_ps(_mm_setr_ps(logits[0], logits[1], logits[2], maxLogit), _mm_set1_ps(maxLogit));
+    x = _mm_max_ps(x, _mm_set1_ps(-87.0f));
+    const __m128 shifted = _mm_fmadd_ps(x, _mm_set1_ps(1.44269504f), _mm_set1_ps(12582912.0f));
+    const __m128 fn = _mm_sub_ps(shifted, _mm_set1_ps(12582912.0f));
+    const __m128 r = _mm_fmadd_ps(fn, _mm_set1_ps(2.12194440e-4f), _mm_fnmadd_ps(fn, _mm_set1_ps(0.693359375f), x));
+    const __m128 r2 = _mm_mul_ps(r, r);
+    const __m128 p01 = _mm_fmadd_ps(_mm_set1_ps(1.6666665459e-1f), r, _mm_set1_ps(5.0000001201e-1f));
+    const __m128 p23 = _mm_fmadd_ps(_mm_set1_ps(8.3334519073e-3f), r, _mm_set1_ps(4.1665795894e-2f));
+    const __m128 p45 = _mm_fmadd_ps(_mm_set1_ps(1.9875691500e-4f), r, _mm_set1_ps(1.3981999507e-3f));
+    const __m128 p = _mm_fmadd_ps(p45, _mm_mul_ps(r2, r2), _mm_fmadd_ps(p23, r2, p01));
+    const __m128 y = _mm_add_ps(_mm_fmadd_ps(p, r2, r), _mm_set1_ps(1.0f));
+    const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_castps_si128(shifted), _mm_set1_epi32(127 - 0x4B400000)), 23));
+    return simdPickActionSSE2(_mm_mul_ps(y, scale), randFloat(randSeed));
+}
+
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+
+__attribute__((target("avx2,fma"))) __m256 simdLogAVX2(__m256 x)
+{
+    __m256i bits = _mm256_castps_si256(x);
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+    bits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F000000));
+    __m256 m = _mm256_castsi256_ps(bits);
+    const __m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(0.707106781f), _CMP_LT_OQ);
+    e = _mm256_blendv_ps(e, _mm256_sub_ps(e, _mm256_set1_ps(1.0f)), small);
+    m = _mm256_blendv_ps(_mm256_sub_ps(m, _mm256_set1_ps(1.0f)), _mm256_sub_ps(_mm256_add_ps(m, m), _mm256_set1_ps(1.0f)), small);
+    const __m256 z = _mm256_mul_ps(m, m);
+    __m256 y = _mm256_set1_ps(7.0376836292e-2f);
+    y = _mm256_sub_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.1514610310e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.1676998740e-1f));
+    y = _mm256_sub_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.2420140846e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.4249322787e-1f));
+    y = _mm256_sub_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.6668057665e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(2.0000714765e-1f));
+    y = _mm256_sub_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(2.4999993993e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(3.3333331174e-1f));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+    y = _mm256_sub_ps(y, _mm256_mul_ps(_mm256_set1_ps(2.12194440e-4f), e));
+    y = _mm256_sub_ps(y, _mm256_mul_ps(_mm256_set1_ps(0.5f), z));
+    return _mm256_add_ps(_mm256_add_ps(m, y), _mm256_mul_ps(_mm256_set1_ps(0.693359375f), e));
+}
+
+// 8 pairs, pair numbers pairs, cos half in z0 and sin half in z1
+__attribute__((target("avx2,fma"))) void simdNormalPairsAVX2(__m256i key, __m256i pairs, __m256 std, __m256 &z0, __m256 &z1)
+{
+    const __m256i counter = _mm256_add_epi32(key, _mm256_add_epi32(pairs, pairs));
+    const __m256i h1 = simdPCGHashAVX2(counter);
+    const __m256i h2 = simdPCGHashAVX2(_mm256_add_epi32(counter, _mm256_set1_epi32(1)));
+    const __m256 u1 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_srli_epi32(h1, 8), _mm256_set1_epi32(1))), _mm256_set1_ps(1.0f / 16777216.0f));
+    const __m256 u2 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(h2, 8)), _mm256_set1_ps(1.0f / 16777216.0f));
+    const __m256 radius = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_mul_ps(_mm256_set1_ps(-2.0f), simdLogAVX2(u1))), std);
+
+    const __m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_set1_ps(4.0f), u2));
+    const __m256 x = _mm256_mul_ps(_mm256_sub_ps(u2, _mm256_mul_ps(_mm256_set1_ps(0.25f), _mm256_cvtepi32_ps(quadrant))), _mm256_set1_ps(6.28318530718f));
+    const __m256 z = _mm256_mul_ps(x, x);
+    __m256 sinX = _mm256_set1_ps(-1.9515295891e-4f);
+    sinX = _mm256_add_ps(_mm256_mul_ps(sinX, z), _mm256_set1_ps(8.3321608736e-3f));
+    sinX = _mm256_sub_ps(_mm256_mul_ps(sinX, z), _mm256_set1_ps(1.6666654611e-1f));
+    sinX = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sinX, z), x), x);
+    __m256 cosX = _mm256_set1_ps(2.443315711809948e-5f);
+    cosX = _mm256_sub_ps(_mm256_mul_ps(cosX, z), _mm256_set1_ps(1.388731625493765e-3f));
+    cosX = _mm256_add_ps(_mm256_mul_ps(cosX, z), _mm256_set1_ps(4.166664568298827e-2f));
+    cosX = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(cosX, z), z), _mm256_mul_ps(_mm256_set1_ps(0.5f), z)), _mm256_set1_ps(1.0f));
+
+    const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    __m256 cosTheta = _mm256_blendv_ps(cosX, sinX, swap);
+    __m256 sinTheta = _mm256_blendv_ps(sinX, cosX, swap);
+    // Sign flips as xor with the sign bit, bit 1 of quadrant + 1 and of quadrant shifted up to bit 31
+    const __m256i cosSign = _mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30);
+    const __m256i sinSign = _mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), 30);
+    cosTheta = _mm256_xor_ps(cosTheta, _mm256_castsi256_ps(cosSign));
+    sinTheta = _mm256_xor_ps(sinTheta, _mm256_castsi256_ps(sinSign));
+    z0 = _mm256_mul_ps(radius, cosTheta);
+    z1 = _mm256_mul_ps(radius, sinTheta);
+}
+
+__attribute__((target("avx2,fma"))) int simdNormalsAVX2(float *dst, uint32_t key, float std, bool add, int n)
+{
+    const __m256i keys = _mm256_set1_epi32((int)key);
+    const __m256 stds = _mm256_set1_ps(std);
+    __m256i pairs = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256 z0, z1;
+        simdNormalPairsAVX2(keys, pairs, stds, z0, z1);
+        pairs = _mm256_add_epi32(pairs, _mm256_set1_epi32(8));
+
+        // Interleave back to pair order, z0[0] z1[0] z0[1] z1[1] ...
+        const __m256 low = _mm256_unpacklo_ps(z0, z1);
+        const __m256 high = _mm256_unpackhi_ps(z0, z1);
+        __m256 first = _mm256_permute2f128_ps(low, high, 0x20);
+        __m256 second = _mm256_permute2f128_ps(low, high, 0x31);
+        if (add)
+        {
+            first = _mm256_add_ps(_mm256_loadu_ps(&dst[i]), first);
+            second = _mm256_add_ps(_mm256_loadu_ps(&dst[i + 8]), second);
+        }
+        _mm256_storeu_ps(&dst[i], first);
+        _mm256_storeu_ps(&dst[i + 8], second);
+    }
+    return i;
+}
+
+#pragma GCC pop_options
+
+// AVX-512, 16 floats at a time
+
+// Some GCC versions warn about the undefined vectors inside their own AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f"))) int simdAddScaledAVX512(float *dst, const float *src, float scale, int n)
+{
+    const __m512 scaleVec = _mm512_set1_ps(scale);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(&dst[i], _mm512_fmadd_ps(_mm512_loadu_ps(&src[i]), scaleVec, _mm512_loadu_ps(&dst[i])));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f"))) int simdAddScaledToAVX512(float *dst, const float *base, const float *src, float scale, int n)
+{
+    const __m512 scaleVec = _mm512_set1_ps(scale);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(&dst[i], _mm512_fmadd_ps(_mm512_loadu_ps(&src[i]), scaleVec, _mm512_loadu_ps(&base[i])));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f"))) int simdMulAVX512(float *dst, float val, int n)
+{
+    const __m512 valVec = _mm512_set1_ps(val);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(&dst[i], _mm512_mul_ps(_mm512_loadu_ps(&dst[i]), valVec));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f"))) int simdFillAVX512(float *dst, float val, int n)
+{
+    const __m512 valVec = _mm512_set1_ps(val);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(&dst[i], valVec);
+    }
+    return i;
+}
+
+__attribute__((target("avx512f"))) int simdDiffSquaredAVX512(const float *a, const float *b, int n, float &sum)
+{
+    __m512 acc = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512 diff = b != nullptr ? _mm512_sub_ps(_mm512_loadu_ps(&a[i]), _mm512_loadu_ps(&b[i])) : _mm512_loadu_ps(&a[i]);
+        acc = _mm512_fmadd_ps(diff, diff, acc);
+    }
+    sum = _mm512_reduce_add_ps(acc);
+    return i;
+}
+
+__attribute__((target("avx512f"))) int simdDotAVX512(const float *a, const float *b, int n, float &sum)
+{
+    __m512 acc = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        acc = _mm512_fmadd_ps(_mm512_loadu_ps(&a[i]), _mm512_loadu_ps(&b[i]), acc);
+    }
+    sum = _mm512_reduce_add_ps(acc);
+    return i;
+}
+
+__attribute__((target("avx512f"))) int simdActivationAVX512(float *hidden, const float *scale, int n)
+{
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 minusOne = _mm512_set1_ps(-1.0f);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512 x = _mm512_mul_ps(_mm512_loadu_ps(&hidden[i]), _mm512_loadu_ps(&scale[i]));
+        __m512 y = _mm512_div_ps(_mm512_add_ps(x, x), _mm512_fmadd_ps(x, x, one));
+        y = _mm512_mask_mov_ps(y, _mm512_cmp_ps_mask(x, one, _CMP_GT_OQ), one);
+        y = _mm512_mask_mov_ps(y, _mm512_cmp_ps_mask(x, minusOne, _CMP_LT_OQ), minusOne);
+        _mm512_storeu_ps(&hidden[i], y);
+    }
+    return i;
+}
+
+__attribute__((target("avx512f"))) int simdMatVec3AVX512(const float *hidden, const float *weights, int n, float *out)
+{
+    const __m512i rows0 = _mm512_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    const __m512i rows1 = _mm512_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    const __m512i rows2 = _mm512_setr_epi32(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512 h = _mm512_loadu_ps(&hidden[i]);
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(&weights[i * 3 + 0]), _mm512_permutexvar_ps(rows0, h), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(&weights[i * 3 + 16]), _mm512_permutexvar_ps(rows1, h), acc1);
+        acc2 = _mm512_fmadd_ps(_mm512_loadu_ps(&weights[i * 3 + 32]), _mm512_permutexvar_ps(rows2, h), acc2);
+    }
+    // Masks of the lanes where l % 3 is 0, 1 and 2
+    const __mmask16 lanes0 = 0x9249;
+    const __mmask16 lanes1 = 0x2492;
+    const __mmask16 lanes2 = 0x4924;
+    out[0] += _mm512_reduce_add_ps(_mm512_mask_blend_ps(lanes0, _mm512_mask_blend_ps(lanes2, acc2, acc1), acc0));
+    out[1] += _mm512_reduce_add_ps(_mm512_mask_blend_ps(lanes1, _mm512_mask_blend_ps(lanes0, acc2, acc1), acc0));
+    out[2] += _mm512_reduce_add_ps(_mm512_mask_blend_ps(lanes2, _mm512_mask_blend_ps(lanes1, acc2, acc1), acc0));
+    return i;
+}
+
+__attribute__((target("avx512f"))) int simdForwardHiddenAVX512(const float *preActivation, const float *scale, const float *weight2, int n, float *out)
+{
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 minusOne = _mm512_set1_ps(-1.0f);
+    const __m512i rows0 = _mm512_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    const __m512i rows1 = _mm512_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    const __m512i rows2 = _mm512_setr_epi32(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512 x = _mm512_mul_ps(_mm512_loadu_ps(&preActivation[i]), _mm512_loadu_ps(&scale[i]));
+        __m512 y = _mm512_div_ps(_mm512_add_ps(x, x), _mm512_fmadd_ps(x, x, one));
+        y = _mm512_mask_mov_ps(y, _mm512_cmp_ps_mask(x, one, _CMP_GT_OQ), one);
+        y = _mm512_mask_mov_ps(y, _mm512_cmp_ps_mask(x, minusOne, _CMP_LT_OQ), minusOne);
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(&weight2[i * 3]), _mm512_permutexvar_ps(rows0, y), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(&weight2[i * 3 + 16]), _mm512_permutexvar_ps(rows1, y), acc1);
+        acc2 = _mm512_fmadd_ps(_mm512_loadu_ps(&weight2[i * 3 + 32]), _mm512_permutexvar_ps(rows2, y), acc2);
+    }
+    out[0] += _mm512_reduce_add_ps(_mm512_mask_blend_ps(0x9249, _mm512_mask_blend_ps(0x4924, acc2, acc1), acc0));
+    out[1] += _mm512_reduce_add_ps(_mm512_mask_blend_ps(0x2492, _mm512_mask_blend_ps(0x9249, acc2, acc1), acc0));
+    out[2] += _mm512_reduce_add_ps(_mm512_mask_blend_ps(0x4924, _mm512_mask_blend_ps(0x2492, acc2, acc1), acc0));
+    return i;
+}
+
+__attribute__((target("avx512f"))) int simdAdamAVX512(float *m, float *v, float *grad, const AdamConstants &c, int n)
+{
+    const __m512 beta1 = _mm512_set1_ps(c.beta1);
+    const __m512 beta2 = _mm512_set1_ps(c.beta2);
+    const __m512 beta1Minus = _mm512_set1_ps(c.beta1Minus);
+    const __m512 beta2Minus = _mm512_set1_ps(c.beta2Minus);
+    const __m512 mHatMul = _mm512_set1_ps(c.mHatMul);
+    const __m512 vHatMul = _mm512_set1_ps(c.vHatMul);
+    const __m512 alpha = _mm512_set1_ps(c.alpha);
+    const __m512 eps = _mm512_set1_ps(c.eps);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512 g = _mm512_loadu_ps(&grad[i]);
+        const __m512 mVal = _mm512_fmadd_ps(beta1, _mm512_loadu_ps(&m[i]), _mm512_mul_ps(beta1Minus, g));
+        const __m512 vVal = _mm512_fmadd_ps(beta2, _mm512_loadu_ps(&v[i]), _mm512_mul_ps(_mm512_mul_ps(beta2Minus, g), g));
+        _mm512_storeu_ps(&m[i], mVal);
+        _mm512_storeu_ps(&v[i], vVal);
+        const __m512 denominator = _mm512_add_ps(_mm512_sqrt_ps(_mm512_mul_ps(vVal, vHatMul)), eps);
+        _mm512_storeu_ps(&grad[i], _mm512_div_ps(_mm512_mul_ps(alpha, _mm512_mul_ps(mVal, mHatMul)), denominator));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f"))) __m512 simdExpAVX512(__m512 x)
+{
+    x = _mm512_max_ps(x, _mm512_set1_ps(-87.0f));
+    const __m512i n = _mm512_cvtps_epi32(_mm512_mul_ps(x, _mm512_set1_ps(1.44269504f)));
+    const __m512 fn = _mm512_cvtepi32_ps(n);
+    const __m512 r = _mm512_fmadd_ps(fn, _mm512_set1_ps(2.12194440e-4f), _mm512_fnmadd_ps(fn, _mm512_set1_ps(0.693359375f), x));
+    __m512 p = _mm512_set1_ps(1.9875691500e-4f);
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.3981999507e-3f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(8.3334519073e-3f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(4.1665795894e-2f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.6666665459e-1f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(5.0000001201e-1f));
+    const __m512 y = _mm512_add_ps(_mm512_fmadd_ps(_mm512_mul_ps(p, r), r, r), _mm512_set1_ps(1.0f));
+    const __m512 scale = _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(n, _mm512_set1_epi32(127)), 23));
+    return _mm512_mul_ps(y, scale);
+}
+
+__attribute__((target("avx512f"))) __m512i simdPCGHashAVX512(__m512i input)
+{
+    const __m512i state = _mm512_add_epi32(_mm512_mullo_epi32(input, _mm512_set1_epi32((int)747796405u)), _mm512_set1_epi32((int)2891336453u));
+    const __m512i shift = _mm512_add_epi32(_mm512_srli_epi32(state, 28), _mm512_set1_epi32(4));
+    const __m512i word = _mm512_mullo_epi32(_mm512_xor_si512(_mm512_srlv_epi32(state, shift), state), _mm512_set1_epi32(277803737));
+    return _mm512_xor_si512(_mm512_srli_epi32(word, 22), word);
+}
+
+__attribute__((target("avx512f"))) __m512 simdRandFloatAVX512(__m512i &seeds)
+{
+    seeds = simdPCGHashAVX512(seeds);
+    return _mm512_mul_ps(_mm512_cvtepu32_ps(seeds), _mm512_set1_ps(1.0f / 4294967296.0f));
+}
+
+__attribute__((target("avx512f"))) int simdSampleActionsAVX512(const float *logits, uint32_t *randSeeds, const uint8_t *active, int n, int32_t *actions)
+{
+    const __m512i offsets = _mm512_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 33, 36, 39, 42, 45);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512 l0 = _mm512_i32gather_ps(offsets, &logits[i * 3], 4);
+        const __m512 l1 = _mm512_i32gather_ps(offsets, &logits[i * 3 + 1], 4);
+        const __m512 l2 = _mm512_i32gather_ps(offsets, &logits[i * 3 + 2], 4);
+        const __m512 maxLogit = _mm512_max_ps(l0, _mm512_max_ps(l1, l2));
+        const __m512 e0 = simdExpAVX512(_mm512_sub_ps(l0, maxLogit));
+        const __m512 e01 = _mm512_add_ps(e0, simdExpAVX512(_mm512_sub_ps(l1, maxLogit)));
+        const __m512 total = _mm512_add_ps(e01, simdExpAVX512(_mm512_sub_ps(l2, maxLogit)));
+
+        __m512i seeds = _mm512_loadu_si512(&randSeeds[i]);
+        const __m512 val = _mm512_mul_ps(simdRandFloatAVX512(seeds), total);
+        __m512i action = _mm512_set1_epi32(2);
+        action = _mm512_mask_blend_epi32(_mm512_cmp_ps_mask(val, e01, _CMP_LT_OQ), action, _mm512_set1_epi32(1));
+        action = _mm512_mask_blend_epi32(_mm512_cmp_ps_mask(val, e0, _CMP_LT_OQ), action, _mm512_setzero_si512());
+
+        __mmask16 store = 0xFFFF;
+        if (active != nullptr)
+        {
+            const __m512i isActive = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)&active[i]));
+            store = _mm512_test_epi32_mask(isActive, isActive);
+        }
+        _mm512_mask_storeu_epi32(&randSeeds[i], store, seeds);
+        _mm512_mask_storeu_epi32(&actions[i], store, action);
+    }
+    return i;
+}
+
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+
+__attribute__((target("avx512f"))) __m512 simdLogAVX512(__m512 x)
+{
+    __m512i bits = _mm512_castps_si512(x);
+    __m512 e = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(126)));
+    bits = _mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(0x007FFFFF)), _mm512_set1_epi32(0x3F000000));
+    __m512 m = _mm512_castsi512_ps(bits);
+    const __mmask16 small = _mm512_cmp_ps_mask(m, _mm512_set1_ps(0.707106781f), _CMP_LT_OQ);
+    e = _mm512_mask_sub_ps(e, small, e, _mm512_set1_ps(1.0f));
+    m = _mm512_mask_blend_ps(small, _mm512_sub_ps(m, _mm512_set1_ps(1.0f)), _mm512_sub_ps(_mm512_add_ps(m, m), _mm512_set1_ps(1.0f)));
+    const __m512 z = _mm512_mul_ps(m, m);
+    __m512 y = _mm512_set1_ps(7.0376836292e-2f);
+    y = _mm512_sub_ps(_mm512_mul_ps(y, m), _mm512_set1_ps(1.1514610310e-1f));
+    y = _mm512_add_ps(_mm512_mul_ps(y, m), _mm512_set1_ps(1.1676998740e-1f));
+    y = _mm512_sub_ps(_mm512_mul_ps(y, m), _mm512_set1_ps(1.2420140846e-1f));
+    y = _mm512_add_ps(_mm512_mul_ps(y, m), _mm512_set1_ps(1.4249322787e-1f));
+    y = _mm512_sub_ps(_mm512_mul_ps(y, m), _mm512_set1_ps(1.6668057665e-1f));
+    y = _mm512_add_ps(_mm512_mul_ps(y, m), _mm512_set1_ps(2.0000714765e-1f));
+    y = _mm512_sub_ps(_mm512_mul_ps(y, m), _mm512_set1_ps(2.4999993993e-1f));
+    y = _mm512_add_ps(_mm512_mul_ps(y, m), _mm512_set1_ps(3.3333331174e-1f));
+    y = _mm512_mul_ps(_mm512_mul_ps(y, m), z);
+    y = _mm512_sub_ps(y, _mm512_mul_ps(_mm512_set1_ps(2.12194440e-4f), e));
+    y = _mm512_sub_ps(y, _mm512_mul_ps(_mm512_set1_ps(0.5f), z));
+    return _mm512_add_ps(_mm512_add_ps(m, y), _mm512_mul_ps(_mm512_set1_ps(0.693359375f), e));
+}
+
+__attribute__((target("avx512f"))) void simdNormalPairsAVX512(__m512i key, __m512i pairs, __m512 std, __m512 &z0, __m512 &z1)
+{
+    const __m512i counter = _mm512_add_epi32(key, _mm512_add_epi32(pairs, pairs));
+    const __m512i h1 = simdPCGHashAVX512(counter);
+    const __m512i h2 = simdPCGHashAVX512(_mm512_add_epi32(counter, _mm512_set1_epi32(1)));
+    const __m512 u1 = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_add_epi32(_mm512_srli_epi32(h1, 8), _mm512_set1_epi32(1))), _mm512_set1_ps(1.0f / 16777216.0f));
+    const __m512 u2 = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srli_epi32(h2, 8)), _mm512_set1_ps(1.0f / 16777216.0f));
+    const __m512 radius = _mm512_mul_ps(_mm512_sqrt_ps(_mm512_mul_ps(_mm512_set1_ps(-2.0f), simdLogAVX512(u1))), std);
+
+    const __m512i quadrant = _mm512_cvtps_epi32(_mm512_mul_ps(_mm512_set1_ps(4.0f), u2));
+    const __m512 x = _mm512_mul_ps(_mm512_sub_ps(u2, _mm512_mul_ps(_mm512_set1_ps(0.25f), _mm512_cvtepi32_ps(quadrant))), _mm512_set1_ps(6.28318530718f));
+    const __m512 z = _mm512_mul_ps(x, x);
+    __m512 sinX = _mm512_set1_ps(-1.9515295891e-4f);
+    sinX = _mm512_add_ps(_mm512_mul_ps(sinX, z), _mm512_set1_ps(8.3321608736e-3f));
+    sinX = _mm512_sub_ps(_mm512_mul_ps(sinX, z), _mm512_set1_ps(1.6666654611e-1f));
+    sinX = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(sinX, z), x), x);
+    __m512 cosX = _mm512_set1_ps(2.443315711809948e-5f);
+    cosX = _mm512_sub_ps(_mm512_mul_ps(cosX, z), _mm512_set1_ps(1.388731625493765e-3f));
+    cosX = _mm512_add_ps(_mm512_mul_ps(cosX, z), _mm512_set1_ps(4.166664568298827e-2f));
+    cosX = _mm512_add_ps(_mm512_sub_ps(_mm512_mul_ps(_mm512_mul_ps(cosX, z), z), _mm512_mul_ps(_mm512_set1_ps(0.5f), z)), _mm512_set1_ps(1.0f));
+
+    const __mmask16 swap = _mm512_test_epi32_mask(quadrant, _mm512_set1_epi32(1));
+    const __m512 cosTheta = _mm512_mask_blend_ps(swap, cosX, sinX);
+    const __m512 sinTheta = _mm512_mask_blend_ps(swap, sinX, cosX);
+    const __m512i cosSign = _mm512_slli_epi32(_mm512_and_si512(_mm512_add_epi32(quadrant, _mm512_set1_epi32(1)), _mm512_set1_epi32(2)), 30);
+    const __m512i sinSign = _mm512_slli_epi32(_mm512_and_si512(quadrant, _mm512_set1_epi32(2)), 30);
+    z0 = _mm512_mul_ps(radius, _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(cosTheta), cosSign)));
+    z1 = _mm512_mul_ps(radius, _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(sinTheta), sinSign)));
+}
+
+__attribute__((target("avx512f"))) int simdNormalsAVX512(float *dst, uint32_t key, float std, bool add, int n)
+{
+    const __m512i keys = _mm512_set1_epi32((int)key);
+    const __m512 stds = _mm512_set1_ps(std);
+    const __m512i firstHalf = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+    const __m512i secondHalf = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+    __m512i pairs = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    int i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m512 z0, z1;
+        simdNormalPairsAVX512(keys, pairs, stds, z0, z1);
+        pairs = _mm512_add_epi32(pairs, _mm512_set1_epi32(16));
+
+        __m512 first = _mm512_permutex2var_ps(z0, firstHalf, z1);
+        __m512 second = _mm512_permutex2var_ps(z0, secondHalf, z1);
+        if (add)
+        {
+            first = _mm512_add_ps(_mm512_loadu_ps(&dst[i]), first);
+            second = _mm512_add_ps(_mm512_loadu_ps(&dst[i + 16]), second);
+        }
+        _mm512_storeu_ps(&dst[i], first);
+        _mm512_storeu_ps(&dst[i + 16], second);
+    }
+    return i;
+}
+
+#pragma GCC pop_options
+
+#pragma GCC diagnostic pop
+
+#endif
+
+// Dispatchers, the vector version does as much as fits its width and the scalar version does the rest
+
+void simdAddScaled(float *dst, const float *src, float scale, int n)
+{
+    int start = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+        start = simdAddScaledAVX512(dst, src, scale, n);
+        break;
+    case SIMD_AVX2:
+        start = simdAddScaledAVX2(dst, src, scale, n);
+        break;
+    case SIMD_SSE2:
+        start = simdAddScaledSSE2(dst, src, scale, n);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdAddScaledScalar(dst, src, scale, start, n);
+}
+
+void simdAddScaledTo(float *dst, const float *base, const float *src, float scale, int n)
+{
+    int start = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+        start = simdAddScaledToAVX512(dst, base, src, scale, n);
+        break;
+    case SIMD_AVX2:
+        start = simdAddScaledToAVX2(dst, base, src, scale, n);
+        break;
+    case SIMD_SSE2:
+        start = simdAddScaledToSSE2(dst, base, src, scale, n);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdAddScaledToScalar(dst, base, src, scale, start, n);
+}
+
+void simdMul(float *dst, float val, int n)
+{
+    int start = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+        start = simdMulAVX512(dst, val, n);
+        break;
+    case SIMD_AVX2:
+        start = simdMulAVX2(dst, val, n);
+        break;
+    case SIMD_SSE2:
+        start = simdMulSSE2(dst, val, n);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdMulScalar(dst, val, start, n);
+}
+
+// dst = val in stores as wide as the kernels that read dst next, so their loads are forwarded from the stores
+void simdFill(float *dst, float val, int n)
+{
+    int start = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+        start = simdFillAVX512(dst, val, n);
+        break;
+    case SIMD_AVX2:
+        start = simdFillAVX2(dst, val, n);
+        break;
+    case SIMD_SSE2:
+        start = simdFillSSE2(dst, val, n);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdFillScalar(dst, val, start, n);
+}
+
+// Sum of (a - b)^2, or of a^2 if b is nullptr
+float simdDiffSquared(const float *a, const float *b, int n)
+{
+    int start = 0;
+    float sum = 0.0f;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+        start = simdDiffSquaredAVX512(a, b, n, sum);
+        break;
+    case SIMD_AVX2:
+        start = simdDiffSquaredAVX2(a, b, n, sum);
+        break;
+    case SIMD_SSE2:
+        start = simdDiffSquaredSSE2(a, b, n, sum);
+        break;
+    default:
+        break;
+    }
+#endif
+    return sum + simdDiffSquaredScalar(a, b, start, n);
+}
+
+float simdDot(const float *a, const float *b, int n)
+{
+    int start = 0;
+    float sum = 0.0f;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+        start = simdDotAVX512(a, b, n, sum);
+        break;
+    case SIMD_AVX2:
+        start = simdDotAVX2(a, b, n, sum);
+        break;
+    case SIMD_SSE2:
+        start = simdDotSSE2(a, b, n, sum);
+        break;
+    default:
+        break;
+    }
+#endif
+    return sum + simdDotScalar(a, b, start, n);
+}
+
+void simdActivation(float *hidden, const float *scale, int n)
+{
+    int start = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+        start = simdActivationAVX512(hidden, scale, n);
+        break;
+    case SIMD_AVX2:
+        start = simdActivationAVX2(hidden, scale, n);
+        break;
+    case SIMD_SSE2:
+        start = simdActivationSSE2(hidden, scale, n);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdActivationScalar(hidden, scale, start, n);
+}
+
+// out = hidden @ weights for (n, 3) weights
+void simdMatVec3(const float *hidden, const float *weights, int n, float *out)
+{
+    out[0] = 0.0f;
+    out[1] = 0.0f;
+    out[2] = 0.0f;
+    int start = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+        start = simdMatVec3AVX512(hidden, weights, n, out);
+        break;
+    case SIMD_AVX2:
+        start = simdMatVec3AVX2(hidden, weights, n, out);
+        break;
+    case SIMD_SSE2:
+        start = simdMatVec3SSE2(hidden, weights, n, out);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdMatVec3Scalar(hidden, weights, start, n, out);
+}
+
+// out = activation(preActivation * scale) @ weight2, simdActivation then simdMatVec3 without storing the activation
+void simdForwardHidden(const float *preActivation, const float *scale, const float *weight2, int n, float *out)
+{
+    out[0] = 0.0f;
+    out[1] = 0.0f;
+    out[2] = 0.0f;
+    int start = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+        start = simdForwardHiddenAVX512(preActivation, scale, weight2, n, out);
+        break;
+    case SIMD_AVX2:
+        start = simdForwardHiddenAVX2(preActivation, scale, weight2, n, out);
+        break;
+    case SIMD_SSE2:
+        start = simdForwardHiddenSSE2(preActivation, scale, weight2, n, out);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdForwardHiddenScalar(preActivation, scale, weight2, start, n, out);
+}
+
+void simdAdam(float *m, float *v, float *grad, const AdamConstants &c, int n)
+{
+    int start = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+        start = simdAdamAVX512(m, v, grad, c, n);
+        break;
+    case SIMD_AVX2:
+        start = simdAdamAVX2(m, v, grad, c, n);
+        break;
+    case SIMD_SSE2:
+        start = simdAdamSSE2(m, v, grad, c, n);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdAdamScalar(m, v, grad, c, start, n);
+}
+
+// dst += src * scale, for int8 src and 0 <= scale <= 255
+void simdAddScaledInt8(int32_t *dst, const int8_t *src, int scale, int n)
+{
+    int start = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+    case SIMD_AVX2:
+        start = simdAddScaledInt8AVX2(dst, src, scale, n);
+        break;
+    case SIMD_SSE2:
+        start = simdAddScaledInt8SSE2(dst, src, scale, n);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdAddScaledInt8Scalar(dst, src, scale, start, n);
+}
+
+// See simdAccumulatorMoveInt8Scalar, length at most 255
+void simdAccumulatorMoveInt8(int32_t *preActivation, int32_t *occupiedSum, const int8_t *head, const int8_t *tail, int length, int n)
+{
+    int start = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+    case SIMD_AVX2:
+        start = simdAccumulatorMoveInt8AVX2(preActivation, occupiedSum, head, tail, length, n);
+        break;
+    case SIMD_SSE2:
+        start = simdAccumulatorMoveInt8SSE2(preActivation, occupiedSum, head, tail, length, n);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdAccumulatorMoveInt8Scalar(preActivation, occupiedSum, head, tail, length, start, n);
+}
+
+void simdActivationInt8(const int32_t *acc, const int8_t *apple, const float *scales, int8_t *hidden, int n)
+{
+    int start = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+    case SIMD_AVX2:
+        start = simdActivationInt8AVX2(acc, apple, scales, hidden, n);
+        break;
+    case SIMD_SSE2:
+        start = simdActivationInt8SSE2(acc, apple, scales, hidden, n);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdActivationInt8Scalar(acc, apple, scales, hidden, start, n);
+}
+
+// sums[c] = x . columns[c * n ... c * n + n - 1] for c < 3, x and columns int8
+void simdDot3Int8(const int8_t *x, const int8_t *columns, int n, int32_t *sums)
+{
+    int start = 0;
+    sums[0] = sums[1] = sums[2] = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+    case SIMD_AVX2:
+        start = simdDot3Int8AVX2(x, columns, n, sums);
+        break;
+    case SIMD_SSE2:
+        start = simdDot3Int8SSE2(x, columns, n, sums);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdDot3Int8Scalar(x, columns, start, n, sums);
+}
+
+// See simdSampleActionsScalar
+void simdSampleActions(const float *logits, uint32_t *randSeeds, const uint8_t *active, int n, int32_t *actions)
+{
+    int start = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+        start = simdSampleActionsAVX512(logits, randSeeds, active, n, actions);
+        break;
+    case SIMD_AVX2:
+        start = simdSampleActionsAVX2(logits, randSeeds, active, n, actions);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdSampleActionsScalar(logits, randSeeds, active, start, n, actions);
+}
+
+// simdSampleActions for one game, for callers that sample as they play
+int32_t simdSampleAction(const float *logits, uint32_t &randSeed)
+{
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+    case SIMD_AVX2:
+        return simdSampleActionAVX2(logits, randSeed);
+    case SIMD_SSE2:
+        return simdSampleActionSSE2(logits, randSeed);
+    default:
+        break;
+    }
+#endif
+    int32_t action;
+    simdSampleActionsScalar(logits, &randSeed, nullptr, 0, 1, &action);
+    return action;
+}
+
+// dst = (or += when add) std * the first n values of the normal stream for key, see simdNormalsScalar
+void simdNormals(float *dst, uint32_t key, float std, bool add, int n)
+{
+    int start = 0;
+#ifdef SIMD_X86
+    switch (getSimdLevel())
+    {
+    case SIMD_AVX512:
+        start = simdNormalsAVX512(dst, key, std, add, n);
+        break;
+    case SIMD_AVX2:
+        start = simdNormalsAVX2(dst, key, std, add, n);
+        break;
+    default:
+        break;
+    }
+#endif
+    simdNormalsScalar(dst, key, std, add, start, n);
+}
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef SOCKET_CONNECTION_HPP
+#define SOCKET_CONNECTION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+/*
+Blocking TCP connections for passing small fixed-layout messages between processes.
+
+SocketListener accepts on a port, SocketConnection connects to a host and port, and both ends then
+move whole messages with sendAll / receiveAll. Nagle's algorithm is off since every message is
+small and waited on. Any failure, including the other end closing, throws std::runtime_error.
+Both ends are expected to be the same build, so structs go over the wire as they are in memory.
+*/
+
+#ifdef _WIN32
+typedef SOCKET SocketHandle;
+const SocketHandle invalidSocket = INVALID_SOCKET;
+#else
+typedef int SocketHandle;
+const SocketHandle invalidSocket = -1;
+#endif
+
+// Winsock needs starting once per process before any other call
+inline void initSockets()
+{
+#ifdef _WIN32
+    static bool started = false;
+    if (!started)
+    {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+        {
+            throw std::runtime_error("Error: Could not start Winsock");
+        }
+        started = true;
+    }
+#endif
+}
+
+inline void closeSocket(SocketHandle handle)
+{
+#ifdef _WIN32
+    closesocket(handle);
+#else
+    ::close(handle);
+#endif
+}
+
+struct SocketConnection
+{
+    SocketHandle handle = invalidSocket;
+
+    SocketConnection() = default;
+
+    explicit SocketConnection(SocketHandle _handle)
+        : handle(_handle)
+    {
+        int noDelay = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char *)&noDelay, sizeof(noDelay));
+    }
+
+    SocketConnection(const SocketConnection &) = delete;
+    SocketConnection &operator=(const SocketConnection &) = delete;
+
+    SocketConnection(SocketConnection &&other) noexcept
+        : handle(other.handle)
+    {
+        other.handle = invalidSocket;
+    }
+
+    SocketConnection &operator=(SocketConnection &&other) noexcept
+    {
+        std::swap(handle, other.handle);
+        return *this;
+    }
+
+    ~SocketConnection()
+    {
+        close();
+    }
+
+    static SocketConnection connect(const std::string &host, int port)
+    {
+        initSockets();
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *addresses = nullptr;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+        {
+            throw std::runtime_error("Error: Could not resolve " + host);
+        }
+        SocketHandle handle = invalidSocket;
+        for (addrinfo *address = addresses; address != nullptr; address = address->ai_next)
+        {
+            handle = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (handle == invalidSocket)
+            {
+                continue;
+            }
+            if (::connect(handle, address->ai_addr, (int)address->ai_addrlen) == 0)
+            {
+                break;
+            }
+            closeSocket(handle);
+            handle = invalidSocket;
+        }
+        freeaddrinfo(addresses);
+        if (handle == invalidSocket)
+        {
+            throw std::runtime_error("Error: Could not connect to " + host + ":" + std::to_string(port));
+        }
+        return SocketConnection(handle);
+    }
+
+    void close()
+    {
+        if (handle != invalidSocket)
+        {
+            closeSocket(handle);
+            handle = invalidSocket;
+        }
+    }
+
+    void sendAll(const void *data, size_t numBytes)
+    {
+        const char *bytes = (const char *)data;
+        while (numBytes > 0)
+        {
+#ifdef MSG_NOSIGNAL
+            const int sent = (int)::send(handle, bytes, (int)numBytes, MSG_NOSIGNAL); // An error instead of SIGPIPE if the other end is gone
+#else
+            const int sent = (int)::send(handle, bytes, (int)numBytes, 0);
+#endif
+            if (sent <= 0)
+            {
+                throw std::runtime_error("Error: Connection lost while sending");
+            }
+            bytes += sent;
+            numBytes -= (size_t)sent;
+        }
+    }
+
+    void receiveAll(void *data, size_t numBytes)
+    {
+        char *bytes = (char *)data;
+        while (numBytes > 0)
+        {
+            const int received = (int)::recv(handle, bytes, (int)numBytes, 0);
+            if (received <= 0)
+            {
+                throw std::runtime_error("Error: Connection lost while receiving");
+            }
+            bytes += received;
+            numBytes -= (size_t)received;
+        }
+    }
+
+    template <typename T>
+    void send(const T &message)
+    {
+        sendAll(&message, sizeof(T));
+    }
+
+    template <typename T>
+    T receive()
+    {
+        T message;
+        receiveAll(&message, sizeof(T));
+        return message;
+    }
+};
+
+struct SocketListener
+{
+    SocketHandle handle = invalidSocket;
+
+    SocketListener(const SocketListener &) = delete;
+    SocketListener &operator=(const SocketListener &) = delete;
+
+    // Listens on every interface, port 0 picks a free port, see getPort
+    explicit SocketListener(int port)
+    {
+        initSockets();
+        handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (handle == invalidSocket)
+        {
+            throw std::runtime_error("Error: Could not create a socket");
+        }
+        int reuse = 1;
+        setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons((uint16_t)port);
+        if (bind(handle, (const sockaddr *)&address, sizeof(address)) != 0 || listen(handle, 64) != 0)
+        {
+            closeSocket(handle);
+            throw std::runtime_error("Error: Could not listen on port " + std::to_string(port));
+        }
+    }
+
+    ~SocketListener()
+    {
+        closeSocket(handle);
+    }
+
+    int getPort() const
+    {
+        sockaddr_in address = {};
+        socklen_t length = sizeof(address);
+        getsockname(handle, (sockaddr *)&address, &length);
+        return ntohs(address.sin_port);
+    }
+
+    SocketConnection accept()
+    {
+        const SocketHandle connection = ::accept(handle, nullptr, nullptr);
+        if (connection == invalidSocket)
+        {
+            throw std::runtime_error("Error: Could not accept a connection");
+        }
+        return SocketConnection(connection);
+    }
+};
+
+#endif
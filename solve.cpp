@@ -0,0 +1,312 @@
+#include "gameSimpleRender.hpp"
+#include "fixedGame.hpp"
+#include "policyTable.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+/*
+Exact solver for small boards.
+
+Enumerates every position reachable from a reset game, then finds the policy that maximizes
+expected apples eaten by value iteration. Eating an apple is a chance node over every free cell
+the next apple can land on.
+
+Eating makes the snake longer, so positions are solved one snake length at a time, longest first.
+Within one length no move earns anything until the apple is eaten, so a position's value is the
+best apple-eating (or dying) exit it can reach, and value iteration within the length only has to
+spread those exit values backwards until nothing changes. Ties go to the exit reached in fewer
+steps, so the policy does not wander.
+
+The policy is written as a PolicyTable that main.cpp and test.cpp memory-map.
+*/
+
+constexpr int gameSize = 4;
+using Game = FixedSnakeGame<gameSize>;
+constexpr int numCells = gameSize * gameSize;
+
+// Bits to hold every value up to maxValue
+constexpr int bitsFor(int maxValue)
+{
+    int bits = 0;
+    while ((1 << bits) <= maxValue)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+// A position's code, from the low bits up: 2 bits per link, the head cell, the length, the apple cell
+constexpr int cellBits = bitsFor(numCells - 1);
+constexpr int lengthBits = bitsFor(numCells);
+constexpr int headShift = 2 * (numCells - 1);
+constexpr int lengthShift = headShift + cellBits;
+constexpr int appleShift = lengthShift + lengthBits;
+constexpr uint64_t cellMask = (1u << cellBits) - 1;
+constexpr uint64_t lengthMask = (1u << lengthBits) - 1;
+static_assert(appleShift + cellBits <= 64, "Positions must pack into a uint64_t");
+
+// Packs a position as apple | length | head | direction of each link, walking from the head to the tail
+uint64_t encode(const Game &game)
+{
+    uint64_t code = 0;
+    int shift = 0;
+    for (int i = game.bodyLength - 1; i > 0; i--)
+    {
+        const int cell = game.body[(game.bodyStart + i) & Game::bodyMask];
+        const int previous = game.body[(game.bodyStart + i - 1) & Game::bodyMask];
+        code |= (uint64_t)zobristLinkDirection(previous, cell, gameSize) << shift;
+        shift += 2;
+    }
+    code |= (uint64_t)game.snakeHeadPosition << headShift;
+    code |= (uint64_t)game.bodyLength << lengthShift;
+    code |= (uint64_t)game.applePosition << appleShift;
+    return code;
+}
+
+void decode(uint64_t code, Game &game)
+{
+    const int length = (int)((code >> lengthShift) & lengthMask);
+    int cells[numCells];
+    cells[length - 1] = (int)((code >> headShift) & cellMask);
+    for (int i = length - 1; i > 0; i--)
+    {
+        // Step back against the link direction
+        const int direction = (int)((code >> (2 * (length - 1 - i))) & 3);
+        const int offsets[4] = {-1, -gameSize, 1, gameSize};
+        cells[i - 1] = cells[i] - offsets[direction];
+    }
+
+    game.occupied = 0;
+    game.hash = 0;
+    for (int i = 0; i < numCells; i++)
+    {
+        game.freeCells[i] = i;
+        game.freeIndex[i] = i;
+    }
+    game.numFree = numCells;
+    game.bodyStart = 0;
+    game.bodyLength = 0;
+    for (int i = 0; i < length; i++)
+    {
+        game.pushHead(cells[i]);
+    }
+    game.snakeHeadPosition = cells[length - 1];
+    game.snakeDirection = zobristLinkDirection(cells[length - 2], cells[length - 1], gameSize);
+    game.applePosition = (int)((code >> appleShift) & cellMask);
+    game.score = length - 2;
+    game.hash ^= zobristDirectionKey(game.snakeDirection) ^ zobristAppleKey(game.applePosition);
+}
+
+void setApple(Game &game, int applePosition)
+{
+    game.hash ^= zobristAppleKey(game.applePosition) ^ zobristAppleKey(applePosition);
+    game.applePosition = applePosition;
+}
+
+int main(int argc, char **argv)
+{
+    const std::string path = argc > 1 ? argv[1] : getPolicyTablePath(gameSize);
+    const auto startTime = std::chrono::steady_clock::now();
+    uint32_t randSeed = 42;
+
+    // Enumerate reachable positions breadth first
+    std::vector<uint64_t> codes;
+    std::unordered_map<uint64_t, int> indices;
+    auto addState = [&](const Game &game)
+    {
+        const uint64_t code = encode(game);
+        if (indices.emplace(code, (int)codes.size()).second)
+        {
+            codes.push_back(code);
+        }
+    };
+
+    Game rootGame = Game(randSeed);
+    for (int i = 0; i < rootGame.numFree; i++)
+    {
+        Game game = rootGame;
+        setApple(game, rootGame.freeCells[i]);
+        addState(game);
+    }
+    const int numRootStates = (int)codes.size();
+
+    // Every position a move can lead to was enumerated above, so a miss here is a bug in encode or decode
+    auto getStateIndex = [&](const Game &game)
+    {
+        const auto found = indices.find(encode(game));
+        if (found == indices.end())
+        {
+            throw std::runtime_error("Error: Position missing from the enumeration");
+        }
+        return found->second;
+    };
+
+    Game game = rootGame;
+    for (size_t i = 0; i < codes.size(); i++)
+    {
+        for (int action = 0; action < 3; action++)
+        {
+            decode(codes[i], game);
+            const int scoreBefore = game.score;
+            if (game.step((SnakeActions)action, randSeed))
+            {
+                continue;
+            }
+            if (game.score > scoreBefore)
+            {
+                for (int j = 0; j < game.numFree; j++)
+                {
+                    setApple(game, game.freeCells[j]);
+                    addState(game);
+                }
+            }
+            else
+            {
+                addState(game);
+            }
+        }
+    }
+    const int numStates = (int)codes.size();
+    std::cout << "Reachable positions: " << numStates << std::endl;
+
+    // Group positions by snake length
+    std::vector<std::vector<int>> layers(numCells + 1);
+    for (int i = 0; i < numStates; i++)
+    {
+        layers[(codes[i] >> lengthShift) & lengthMask].push_back(i);
+    }
+
+    std::vector<float> values(numStates, -1.0f);
+    std::vector<int> distances(numStates, std::numeric_limits<int>::max());
+    std::vector<uint8_t> bestActions(numStates, SnakeActions::NO_TURN);
+
+    // Per position and action: the position it leads to at the same length, or -1 for an exit with exitValues
+    std::vector<int> nextStates(numStates * 3);
+    std::vector<float> exitValues(numStates * 3);
+
+    for (int length = numCells; length >= 2; length--)
+    {
+        const std::vector<int> &layer = layers[length];
+        for (int state : layer)
+        {
+            for (int action = 0; action < 3; action++)
+            {
+                decode(codes[state], game);
+                const int scoreBefore = game.score;
+                const bool gameOver = game.step((SnakeActions)action, randSeed);
+                const bool ateApple = game.score > scoreBefore;
+                nextStates[state * 3 + action] = -1;
+                if (gameOver)
+                {
+                    exitValues[state * 3 + action] = ateApple ? 1.0f : 0.0f;
+                }
+                else if (ateApple)
+                {
+                    // Chance node, every free cell is equally likely
+                    double total = 0.0;
+                    for (int j = 0; j < game.numFree; j++)
+                    {
+                        setApple(game, game.freeCells[j]);
+                        total += values[getStateIndex(game)];
+                    }
+                    exitValues[state * 3 + action] = 1.0f + (float)(total / (double)game.numFree);
+                }
+                else
+                {
+                    nextStates[state * 3 + action] = getStateIndex(game);
+                }
+            }
+        }
+
+        // Spread exit values back through the moves that stay at this length
+        bool changed = true;
+        int sweeps = 0;
+        while (changed)
+        {
+            changed = false;
+            sweeps++;
+            for (int state : layer)
+            {
+                for (int action = 0; action < 3; action++)
+                {
+                    const int next = nextStates[state * 3 + action];
+                    float value;
+                    int distance;
+                    if (next < 0)
+                    {
+                        value = exitValues[state * 3 + action];
+                        distance = 1;
+                    }
+                    else if (values[next] >= 0.0f)
+                    {
+                        value = values[next];
+                        distance = distances[next] + 1;
+                    }
+                    else
+                    {
+                        continue;
+                    }
+                    if (value > values[state] || (value == values[state] && distance < distances[state]))
+                    {
+                        values[state] = value;
+                        distances[state] = distance;
+                        bestActions[state] = action;
+                        changed = true;
+                    }
+                }
+            }
+        }
+        if (!layer.empty())
+        {
+            std::cout << "Solved length " << length << ": " << layer.size() << " positions, " << sweeps << " sweeps" << std::endl;
+        }
+    }
+
+    // Expected apples from a reset game, the apple lands on any free cell
+    double optimalScore = 0.0;
+    for (int i = 0; i < numRootStates; i++)
+    {
+        optimalScore += values[i];
+    }
+    optimalScore /= (double)numRootStates;
+    std::cout << "Optimal expected score: " << optimalScore << std::endl;
+
+    // Build the table, at most half full so probe sequences stay short
+    uint64_t numSlots = 1;
+    while (numSlots < (uint64_t)numStates * 2)
+    {
+        numSlots *= 2;
+    }
+    std::vector<uint64_t> slots(numSlots, 0);
+    std::unordered_map<uint64_t, uint64_t> keys;
+    for (int i = 0; i < numStates; i++)
+    {
+        decode(codes[i], game);
+        const uint64_t key = game.hash & PolicyTable::keyMask;
+        if (key == 0 || !keys.emplace(key, codes[i]).second)
+        {
+            std::cout << "Hash collision between reachable positions, can not build the table" << std::endl;
+            return 1;
+        }
+        PolicyTable::insert(slots, game.hash, (SnakeActions)bestActions[i]);
+    }
+
+    fs::path outputPath = fs::path(path);
+    if (outputPath.has_parent_path())
+    {
+        fs::create_directories(outputPath.parent_path());
+    }
+    if (!PolicyTable::save(path, gameSize, numStates, optimalScore, slots))
+    {
+        std::cout << "Could not write " << path << std::endl;
+        return 1;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Wrote " << path << " (" << (sizeof(PolicyTableHeader) + numSlots * sizeof(uint64_t)) / (1024 * 1024) << " MB) in " << seconds << "s" << std::endl;
+
+    return 0;
+}
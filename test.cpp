@@ -1,7 +1,10 @@
 #include "game.hpp"
 #include "customUtils.hpp"
+#include "policyTable.hpp"
+#include "quantizedModel.hpp"
 
-float testModel(const SnakeGame &game, SnakeModel &model, Matrix &out, uint32_t &randSeed, const int iters, const int appleTolerance)
+template <typename Model>
+float testModel(const SnakeGame &game, Model &model, Matrix &out, uint32_t &randSeed, const int iters, const int appleTolerance)
 {
     // Copy of game for test runs
     SnakeGame newGame = SnakeGame(game.size, randSeed);
@@ -21,7 +24,7 @@ float testModel(const SnakeGame &game, SnakeModel &model, Matrix &out, uint32_t
         while (!gameOver)
         {
             // Model forward
-            model.forward(newGame.board, newGame.applePosition, out);
+            model.forward(newGame.getBoard(), newGame.applePosition, out);
 
             // Take step
             const int preStepScore = newGame.score;
@@ -46,6 +49,46 @@ float testModel(const SnakeGame &game, SnakeModel &model, Matrix &out, uint32_t
     return totalScore / (float)iters;
 }
 
+// Same as testModel, but plays the solved policy
+float testPolicy(const SnakeGame &game, const PolicyTable &policy, uint32_t &randSeed, const int iters, const int appleTolerance)
+{
+    SnakeGame newGame = SnakeGame(game.size, randSeed);
+    float totalScore = 0.0f;
+
+    for (int i = 0; i < iters; i++)
+    {
+        newGame.copyState(game);
+        newGame.randomizeApplePosition(randSeed);
+
+        int numSteps = 0;
+        int lastAppleStep = 0;
+        bool gameOver = false;
+        while (!gameOver)
+        {
+            SnakeActions action;
+            if (!policy.getAction(newGame.hash, action))
+            {
+                throw std::runtime_error("Error: Position " + std::to_string(newGame.hash) + " is not in the policy table");
+            }
+
+            const int preStepScore = newGame.score;
+            gameOver = newGame.step(action, randSeed);
+            if (newGame.score > preStepScore)
+            {
+                lastAppleStep = numSteps;
+            }
+            else if (numSteps - lastAppleStep > appleTolerance)
+            {
+                gameOver = true;
+            }
+            numSteps++;
+        }
+        totalScore += newGame.score;
+    }
+
+    return totalScore / (float)iters;
+}
+
 int main()
 {
     // Init window
@@ -69,7 +112,7 @@ int main()
     int trainingRun;
     std::cout << "Enter training run #: ";
     std::cin >> trainingRun;
-    SnakeModel model = SnakeModel(1, 1).loadFromFile("trainingRuns/" + std::to_string(trainingRun) + "/model.bin");
+    SnakeModel model = SnakeModel::mapFromFile("trainingRuns/" + std::to_string(trainingRun) + "/model.bin");
     Matrix out = Matrix(1, 3);
     std::cout << "Loaded model with " << model.getNumParams() << " parameters" << std::endl;
 
@@ -82,6 +125,31 @@ int main()
     float score = testModel(game, model, out, randSeed, 1000, game.size * game.size);
     std::cout << "Model Avg. Score: " << score << std::endl;
 
+    // Int8 copy for serving, and how far it moves the model's actions
+    QuantizedSnakeModel quantizedModel = QuantizedSnakeModel(model);
+    uint32_t quantizedSeed = 42;
+    float quantizedScore = testModel(game, quantizedModel, out, quantizedSeed, 1000, game.size * game.size);
+    QuantizationDrift drift = measureQuantizationDrift<SnakeGame>(model, quantizedModel, 100000, 42);
+    std::cout << "Int8 Model Avg. Score: " << quantizedScore << " (" << quantizedModel.getNumBytes() << " bytes, float model "
+              << model.getNumParams() * sizeof(float) << " bytes)" << std::endl;
+    std::cout << "Int8 drift over " << drift.numPositions << " positions: argmax agrees " << 100.0f * drift.argmaxAgreement
+              << "%, sampled action agrees " << 100.0f * drift.sampleAgreement << "%, action distribution total variation mean "
+              << drift.meanTotalVariation << " max " << drift.maxTotalVariation << ", max logit error " << drift.maxLogitError << std::endl;
+
+    // Ceiling for the model score, if solve has been run for this board size. The model score stops a game after
+    // size * size steps without an apple, and the solved policy can need more than that, so it plays under both rules:
+    // with the same limit as the model, the comparable ceiling, and with none, the table's expected score
+    PolicyTable policy;
+    if (policy.load(getPolicyTablePath(game.size), game.size))
+    {
+        uint32_t policySeed = randSeed;
+        float policyScore = testPolicy(game, policy, policySeed, 1000, game.size * game.size);
+        std::cout << "Optimal Policy Avg. Score, same step limit as the model: " << policyScore << std::endl;
+        policySeed = randSeed;
+        float unlimitedPolicyScore = testPolicy(game, policy, policySeed, 1000, std::numeric_limits<int>::max());
+        std::cout << "Optimal Policy Avg. Score, no step limit: " << unlimitedPolicyScore << " (" << policy.header->optimalScore << " expected)" << std::endl;
+    }
+
     while (window.isOpen())
     {
         sf::Event event;
@@ -101,7 +169,7 @@ int main()
         if (gameClock.getElapsedTime().asSeconds() > tickSpeed)
         {
             // Model forward
-            model.forward(game.board, game.applePosition, out);
+            model.forward(game.getBoard(), game.applePosition, out);
 
             // Update game
             /*bool gameOver;
@@ -0,0 +1,219 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Persistent worker threads.
+
+start(job) wakes every worker and runs job(threadIndex) once on each of them without blocking the
+caller, so a render loop can keep polling isDone(). run(job) does the same and waits for it.
+Only one job runs at a time, start() waits for the previous one to finish.
+
+runTasks(numTasks, task) is a work stealing loop over task indices [0, numTasks). Every worker
+starts with an even contiguous share and calls task(threadIndex, taskIndex) on it front to back.
+A worker that runs out steals the back half of the largest share left, so uneven task lengths
+still keep every thread busy until the end. Which thread runs a task is up to timing, so tasks
+should write their results by task index.
+*/
+
+// [begin, end) of task indices packed into one word, so the owner taking from the front and a thief
+// taking from the back agree through a single compare exchange
+struct alignas(64) TaskRange
+{
+    std::atomic<uint64_t> range{0};
+
+    static uint64_t pack(uint32_t begin, uint32_t end)
+    {
+        return ((uint64_t)end << 32) | begin;
+    }
+};
+
+struct ThreadPool
+{
+    int numThreads;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    std::function<void(int)> job;
+    uint64_t jobId = 0;
+    int numWorking = 0;
+    bool stopping = false;
+
+    std::vector<TaskRange> taskRanges;
+
+    ThreadPool(int _numThreads = 0)
+    {
+        numThreads = _numThreads > 0 ? _numThreads : std::max(1, (int)std::thread::hardware_concurrency());
+        taskRanges = std::vector<TaskRange>(numThreads);
+        for (int i = 0; i < numThreads; i++)
+        {
+            threads.emplace_back([this, i]
+                                 { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void workerLoop(int threadIndex)
+    {
+        uint64_t lastJobId = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobReady.wait(lock, [&]
+                              { return stopping || jobId != lastJobId; });
+                if (stopping)
+                {
+                    return;
+                }
+                lastJobId = jobId;
+            }
+
+            job(threadIndex);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                numWorking--;
+                if (numWorking == 0)
+                {
+                    jobDone.notify_all();
+                }
+            }
+        }
+    }
+
+    void start(std::function<void(int)> _job)
+    {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = std::move(_job);
+            numWorking = numThreads;
+            jobId++;
+        }
+        jobReady.notify_all();
+    }
+
+    bool isDone()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return numWorking == 0;
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        jobDone.wait(lock, [&]
+                     { return numWorking == 0; });
+    }
+
+    void run(std::function<void(int)> _job)
+    {
+        start(std::move(_job));
+        wait();
+    }
+
+    // Next task from the front of this thread's own range, -1 once it is empty
+    int popTask(int threadIndex)
+    {
+        std::atomic<uint64_t> &range = taskRanges[threadIndex].range;
+        uint64_t current = range.load();
+        while (true)
+        {
+            const uint32_t begin = (uint32_t)current;
+            const uint32_t end = (uint32_t)(current >> 32);
+            if (begin >= end)
+            {
+                return -1;
+            }
+            if (range.compare_exchange_weak(current, TaskRange::pack(begin + 1, end)))
+            {
+                return (int)begin;
+            }
+        }
+    }
+
+    // Moves the back half of the largest other range into this thread's range, false once every range is empty
+    bool stealTasks(int threadIndex)
+    {
+        while (true)
+        {
+            int victim = -1;
+            uint64_t victimRange = 0;
+            uint32_t mostLeft = 0;
+            for (int i = 0; i < numThreads; i++)
+            {
+                const uint64_t current = taskRanges[i].range.load();
+                const uint32_t left = (uint32_t)(current >> 32) - std::min((uint32_t)(current >> 32), (uint32_t)current);
+                if (i != threadIndex && left > mostLeft)
+                {
+                    victim = i;
+                    victimRange = current;
+                    mostLeft = left;
+                }
+            }
+            if (victim < 0)
+            {
+                return false;
+            }
+
+            const uint32_t begin = (uint32_t)victimRange;
+            const uint32_t end = (uint32_t)(victimRange >> 32);
+            const uint32_t split = end - std::max(1u, mostLeft / 2);
+            if (taskRanges[victim].range.compare_exchange_strong(victimRange, TaskRange::pack(begin, split)))
+            {
+                // Only this thread writes its own range while it is empty
+                taskRanges[threadIndex].range.store(TaskRange::pack(split, end));
+                return true;
+            }
+        }
+    }
+
+    template <typename Task>
+    void runTasks(int numTasks, Task &&task)
+    {
+        wait();
+        for (int i = 0; i < numThreads; i++)
+        {
+            const uint32_t begin = (uint32_t)((int64_t)numTasks * i / numThreads);
+            const uint32_t end = (uint32_t)((int64_t)numTasks * (i + 1) / numThreads);
+            taskRanges[i].range.store(TaskRange::pack(begin, end));
+        }
+        run([this, &task](int threadIndex)
+            {
+                do
+                {
+                    for (int taskIndex = popTask(threadIndex); taskIndex >= 0; taskIndex = popTask(threadIndex))
+                    {
+                        task(threadIndex, taskIndex);
+                    }
+                } while (stealTasks(threadIndex)); });
+    }
+};
+
+#endif
@@ -1,6 +1,14 @@
 #include "game.hpp"
+#include "fixedGame.hpp"
+#include "fixedModel.hpp"
+#include "vecEnv.hpp"
+#include "threadPool.hpp"
+#include "noiseTable.hpp"
+#include "esCluster.hpp"
+#include "policyTable.hpp"
 #include "customUtils.hpp"
 #include <filesystem>
+#include <sstream>
 
 namespace fs = std::filesystem;
 
@@ -50,10 +58,11 @@ int getNextTrainingRun(const std::string &directory)
     }
 }
 
-float testModel(const SnakeGame &game, SnakeModel &model, Matrix &out, uint32_t &randSeed, const int iters, const int appleTolerance)
+template <typename Game, typename Model>
+float testModel(const Game &game, Model &model, Matrix &out, uint32_t &randSeed, const int iters, const int appleTolerance, HiddenAccumulator *accumulator = nullptr)
 {
     // Copy of game for test runs
-    SnakeGame newGame = SnakeGame(game.size, randSeed);
+    Game newGame = Game(game.size, randSeed);
     float totalScore = 0.0f;
     float maxScore = 0.0f;
 
@@ -62,6 +71,10 @@ float testModel(const SnakeGame &game, SnakeModel &model, Matrix &out, uint32_t
         // Reset game state
         newGame.copyState(game);
         newGame.randomizeApplePosition(randSeed);
+        if (accumulator != nullptr)
+        {
+            accumulator->refresh(model.weight0, newGame.getBoard());
+        }
 
         // Play game to end
         int numSteps = 0;
@@ -70,11 +83,24 @@ float testModel(const SnakeGame &game, SnakeModel &model, Matrix &out, uint32_t
         while (!gameOver)
         {
             // Model forward
-            model.forward(newGame.board, newGame.applePosition, out);
+            if (accumulator != nullptr)
+            {
+                model.forward(*accumulator, newGame.applePosition, out);
+            }
+            else
+            {
+                model.forward(newGame.getBoard(), newGame.applePosition, out);
+            }
 
             // Take step
             const int preStepScore = newGame.score;
-            gameOver = newGame.step(sampleAction(out, randSeed), randSeed);
+            const int preStepTail = newGame.getTailPosition();
+            const int preStepLength = newGame.bodyLength;
+            gameOver = newGame.step(sampleActionFast(out, randSeed), randSeed);
+            if (!gameOver && accumulator != nullptr)
+            {
+                accumulator->update(model.weight0, newGame, preStepTail, preStepLength);
+            }
             if (newGame.score > preStepScore)
             {
                 lastAppleStep = numSteps;
@@ -95,8 +121,127 @@ float testModel(const SnakeGame &game, SnakeModel &model, Matrix &out, uint32_t
     return totalScore / (float)iters;
 }
 
-int main()
+// Same as testModel, but plays all iters games in lockstep on a VecSnakeEnv.
+// Each step fills row i of logits (iters rows) for every active game, then samples all of their actions in one call
+template <int N, typename Model>
+float testModelVec(const FixedSnakeGame<N> &game, Model &model, Matrix &logits, VecSnakeEnv<N> &env, std::vector<int32_t> &actions, const int iters, std::vector<HiddenAccumulator> *accumulators = nullptr)
 {
+    env.reset(game, iters);
+    if (accumulators != nullptr)
+    {
+        for (int i = 0; i < env.numGames; i++)
+        {
+            if (env.active[i])
+            {
+                (*accumulators)[i].refresh(model.weight0, env.getBoard(i));
+            }
+        }
+    }
+
+    while (env.numActive > 0)
+    {
+        for (int i = 0; i < env.numGames; i++)
+        {
+            if (env.active[i])
+            {
+                Matrix out = Matrix::view(&logits.values[i * 3], 1, 3);
+                if (accumulators != nullptr)
+                {
+                    model.forward((*accumulators)[i], env.apples[i], out);
+                }
+                else
+                {
+                    model.forward(env.getBoard(i), env.apples[i], out);
+                }
+            }
+        }
+        sampleActions(logits, env.randSeeds.data(), env.active.data(), env.numGames, actions.data());
+        env.step(actions.data());
+
+        // Catch the accumulators up with the step, games that started a new episode start over
+        if (accumulators != nullptr)
+        {
+            for (int i = 0; i < env.numGames; i++)
+            {
+                HiddenAccumulator &accumulator = (*accumulators)[i];
+                if (!env.active[i])
+                {
+                    continue;
+                }
+                if (env.done[i])
+                {
+                    accumulator.refresh(model.weight0, env.getBoard(i));
+                }
+                else if (env.ateApple[i])
+                {
+                    accumulator.grow(model.weight0, env.newHeads[i], env.bodyLengths[i]);
+                }
+                else
+                {
+                    accumulator.move(model.weight0, env.leftTails[i], env.newHeads[i], env.bodyLengths[i]);
+                }
+            }
+        }
+    }
+
+    return env.totalScore / (float)env.episodesFinished;
+}
+
+// Everything one pool thread needs to play games of a perturbed model on its own
+template <int N, int Hidden>
+struct TrialWorker
+{
+    SnakeModel modelCopy;
+    FixedSnakeModel<N, Hidden> fixedModel;
+    VecSnakeEnv<N> vecEnv;
+    std::vector<int32_t> vecActions;
+    Matrix vecLogits;
+    Matrix out;
+    HiddenAccumulator accumulator;
+    std::vector<HiddenAccumulator> vecAccumulators;
+    Matrix base; // Weights an async trial started from, copied from the model under its lock
+    int trial = -1; // Trial whose perturbation modelCopy holds, -1 after the model changes
+
+    TrialWorker(int gamesPerChunk, int appleTolerance)
+        : modelCopy(N, Hidden),
+          vecEnv(gamesPerChunk, 0, appleTolerance),
+          vecActions(gamesPerChunk),
+          vecLogits(gamesPerChunk, 3),
+          out(1, 3),
+          accumulator(Hidden),
+          vecAccumulators(gamesPerChunk),
+          base(1, FixedSnakeModel<N, Hidden>::numParams)
+    {
+        for (HiddenAccumulator &vecAccumulator : vecAccumulators)
+        {
+            vecAccumulator = HiddenAccumulator(Hidden);
+        }
+    }
+};
+
+// One trial played by the async pool against the weights of one model version
+struct AsyncTrialResult
+{
+    uint32_t trialSeed = 0;
+    NoisePerturbation perturbation;
+    int version = 0;
+    float scores[2] = {}; // At +sigma and -sigma, only the first without antithetic pairs
+};
+
+// train                                    trains in this process
+// train coordinator <port> <numWorkers>    trains with the trials played by numWorkers worker processes
+// train worker <host> <port> [numThreads]  plays trials for the coordinator at host:port
+int main(int argc, char **argv)
+{
+    const std::string mode = argc > 1 ? argv[1] : "local";
+    const bool isCoordinator = mode == "coordinator" && argc >= 4;
+    const bool isWorker = mode == "worker" && argc >= 4;
+    if (mode != "local" && !isCoordinator && !isWorker)
+    {
+        std::cerr << "Usage: train | train coordinator <port> <numWorkers> | train worker <host> <port> [numThreads]" << std::endl;
+        return 1;
+    }
+
     // Settings
     constexpr int gameSize = 4;
 
@@ -107,36 +252,103 @@ int main()
     int appleTolerance = gameSize * gameSize;
     const int hiddenSize = 32;
     std::string optimizerType = "sgd";
+    bool useVecEnv = true; // Play each trial's games in lockstep on a VecSnakeEnv instead of one at a time
+    bool useAccumulator = true; // Update board @ weight0 from each move instead of recomputing it
+    bool useFixedModel = false; // Play trials with a FixedSnakeModel compiled for gameSize and hiddenSize
+    bool useFastNoise = true; // Draw perturbations from the vectorized counter-based generator instead of randDist
+    bool useThreadPool = true; // Play trials as (trial, game chunk) tasks on a work stealing pool, same results for any thread count
+    int numThreads = 0; // Pool size, 0 for one thread per core
+    int gamesPerChunk = 50; // Games of a trial played as one pool task
+    bool useNoiseTable = true; // Perturb with (offset, sign) slices of one shared table of normals instead of drawing noise per trial
+    int noiseTableSize = 1 << 22; // Values in the noise table, should be many times the number of parameters
+    bool useAntithetic = true; // Trials come in pairs playing the same noise at +sigma and -sigma, nTrials must be even
+    bool useSlicedGradient = true; // Build the gradient one parameter slice per pool task, streaming every trial's noise into it
+    int gradientSliceSize = 4096; // Parameters per slice, a multiple of 32
+    bool useAsync = false; // Pool threads play trials nonstop against the newest weights, a step is taken every nTrials results
+    int maxStaleness = 4; // Async results more versions behind than this are dropped, newer stale ones are importance weighted
 
     int logInterval = 100;
 
-    // Get training run ID
-    int currentTrainingRun = getNextTrainingRun("trainingRuns");
-    std::string currentTrainingRunPath = "trainingRuns/" + std::to_string(currentTrainingRun);
+    // Processes only agree on a trial's seeds when they come from hashes, as on the pool, and they have to step in lockstep
+    if (isCoordinator || isWorker)
+    {
+        useThreadPool = true;
+        useAsync = false;
+    }
+    if (useAsync)
+    {
+        useThreadPool = true;
+    }
+
+    // Config, saved with the run and checked against every worker's
+    std::ostringstream configText;
+    configText << "gameSize: " << gameSize << "\n";
+    configText << "nTrials: " << nTrials << "\n";
+    configText << "itersPerTrial: " << itersPerTrial << "\n";
+    configText << "sigma: " << sigma << "\n";
+    configText << "learningRate: " << learningRate << "\n";
+    configText << "appleTolerance: " << appleTolerance << "\n";
+    configText << "hiddenSize: " << hiddenSize << "\n";
+    configText << "optimizerType: " << optimizerType << "\n";
+    configText << "useVecEnv: " << useVecEnv << "\n";
+    configText << "useAccumulator: " << useAccumulator << "\n";
+    configText << "useFixedModel: " << useFixedModel << "\n";
+    configText << "useFastNoise: " << useFastNoise << "\n";
+    configText << "useThreadPool: " << useThreadPool << "\n";
+    configText << "numThreads: " << numThreads << "\n";
+    configText << "gamesPerChunk: " << gamesPerChunk << "\n";
+    configText << "useNoiseTable: " << useNoiseTable << "\n";
+    configText << "noiseTableSize: " << noiseTableSize << "\n";
+    configText << "useAntithetic: " << useAntithetic << "\n";
+    configText << "useSlicedGradient: " << useSlicedGradient << "\n";
+    configText << "gradientSliceSize: " << gradientSliceSize << "\n";
+    configText << "useAsync: " << useAsync << "\n";
+    configText << "maxStaleness: " << maxStaleness << "\n";
+    const std::string config = configText.str();
+
+    // Get training run ID, workers keep no run of their own
+    std::string currentTrainingRunPath;
+    if (!isWorker)
+    {
+        int currentTrainingRun = getNextTrainingRun("trainingRuns");
+        currentTrainingRunPath = "trainingRuns/" + std::to_string(currentTrainingRun);
+
+        // Create directory for training run
+        if (fs::create_directories(currentTrainingRunPath))
+        {
+            std::cout << "Directory created successfully: " << currentTrainingRunPath << std::endl;
+        }
+        else
+        {
+            std::cerr << "Failed to create directory: " << currentTrainingRunPath << std::endl;
+        }
+
+        // Save config
+        std::ofstream configFile(currentTrainingRunPath + "/config.txt", std::ios::out);
+        if (configFile.is_open())
+        {
+            configFile << config;
+            configFile.close();
+        }
+    }
 
-    // Create directory for training run
-    if (fs::create_directories(currentTrainingRunPath))
+    // The pool size does not change results, so each worker can pick its own
+    if (isWorker && argc >= 5)
     {
-        std::cout << "Directory created successfully: " << currentTrainingRunPath << std::endl;
+        numThreads = std::stoi(argv[4]);
     }
-    else
+
+    if (useAntithetic && nTrials % 2 != 0)
     {
-        std::cerr << "Failed to create directory: " << currentTrainingRunPath << std::endl;
+        std::cerr << "Antithetic sampling needs an even nTrials, got " << nTrials << std::endl;
+        return 1;
     }
 
-    // Save config
-    std::ofstream file(currentTrainingRunPath + "/config.txt", std::ios::out); // Open in append mode
-    if (file.is_open())
+    // Slices start on even indices for addFastRandRange and on whole cache lines for the noise table
+    if (useSlicedGradient && (gradientSliceSize <= 0 || gradientSliceSize % 32 != 0))
     {
-        file << "gameSize: " << gameSize << "\n";
-        file << "nTrials: " << nTrials << "\n";
-        file << "itersPerTrial: " << itersPerTrial << "\n";
-        file << "sigma: " << sigma << "\n";
-        file << "learningRate: " << learningRate << "\n";
-        file << "appleTolerance: " << appleTolerance << "\n";
-        file << "hiddenSize: " << hiddenSize << "\n";
-        file << "optimizerType: " << optimizerType << "\n";
-        file.close();
+        std::cerr << "The gradient slice size must be a positive multiple of 32, got " << gradientSliceSize << std::endl;
+        return 1;
     }
 
     std::cout << "Initializing game" << std::endl;
@@ -144,82 +356,580 @@ int main()
     sf::Clock gameClock;
     uint32_t gameRandSeed = 42;
     uint32_t randSeed = 42;
-    SnakeGame game = SnakeGame(gameSize, gameRandSeed);
+    uint32_t noiseTableSeed = 42;
+    FixedSnakeGame<gameSize> game = FixedSnakeGame<gameSize>(gameRandSeed);
+    VecSnakeEnv<gameSize> vecEnv = VecSnakeEnv<gameSize>(itersPerTrial, gameRandSeed, appleTolerance);
+    std::vector<int32_t> vecActions(itersPerTrial);
+    uint32_t pairGameRandSeed = gameRandSeed;          // Game seeds an antithetic pair starts from when trials play one at a time
+    std::vector<uint32_t> pairVecSeeds(itersPerTrial); // Same for vecEnv's games
     std::cout << "Initialized game" << std::endl;
 
+    // Solved policy's expected score, logged next to the model score when solve has been run for gameSize
+    PolicyTable policy;
+    policy.load(getPolicyTablePath(gameSize), gameSize);
+
     // Init neural network stuff
     std::string savePath = currentTrainingRunPath + "/model.bin";
+    std::string logPath = currentTrainingRunPath + "/log.txt";
     SnakeModel model = SnakeModel(gameSize, hiddenSize);
     SnakeModel originalModel = SnakeModel(gameSize, hiddenSize);
     originalModel.copyWeights(model);
     SnakeModel modelCopy = SnakeModel(gameSize, hiddenSize);
+    FixedSnakeModel<gameSize, hiddenSize> fixedModel;
     Matrix grad = Matrix(1, model.getNumParams());
     AdamOptimizer adamOptim = AdamOptimizer(model.getNumParams(), learningRate);
     Matrix out = Matrix(1, 3);
+    HiddenAccumulator accumulator = HiddenAccumulator(hiddenSize);
+    std::vector<HiddenAccumulator> vecAccumulators(itersPerTrial);
+    for (HiddenAccumulator &vecAccumulator : vecAccumulators)
+    {
+        vecAccumulator = HiddenAccumulator(hiddenSize);
+    }
+    HiddenAccumulator *accumulatorPtr = useAccumulator ? &accumulator : nullptr;
+    std::vector<HiddenAccumulator> *vecAccumulatorsPtr = useAccumulator ? &vecAccumulators : nullptr;
+    Matrix vecLogits = Matrix(itersPerTrial, 3);
     std::cout << "Initialized model" << std::endl;
 
     float *scores = new float[nTrials];
 
+    // Pool mode: every trial gets its own noise seed and every chunk its own game seed, so no task depends on another
+    ThreadPool pool = ThreadPool(useThreadPool ? numThreads : 1);
+    std::vector<TrialWorker<gameSize, hiddenSize>> workers;
+    workers.reserve(pool.numThreads);
+    for (int i = 0; i < pool.numThreads; i++)
+    {
+        workers.emplace_back(gamesPerChunk, appleTolerance);
+    }
+    const int numChunks = (itersPerTrial + gamesPerChunk - 1) / gamesPerChunk;
+    std::vector<uint32_t> trialSeeds(nTrials);
+
+    // Built once and only read after, by the pool threads too
+    const NoiseTable noiseTable = NoiseTable(useNoiseTable ? noiseTableSize : 16, noiseTableSeed);
+    std::vector<NoisePerturbation> perturbations(nTrials);
+    std::vector<float> trialWeights(nTrials);
+    std::vector<float> chunkScores(nTrials * numChunks);
+    const int trialStride = useAntithetic ? 2 : 1;
+
+    // A worker's model copy = base + sigma * a trial's noise, the perturbation's sign mirrors drawn noise too
+    auto perturbWorker = [&](TrialWorker<gameSize, hiddenSize> &worker, const Matrix &base, const NoisePerturbation &perturbation, uint32_t trialSeed)
+    {
+        if (useNoiseTable)
+        {
+            noiseTable.perturb(base, worker.modelCopy.params, perturbation, sigma);
+        }
+        else
+        {
+            worker.modelCopy.params.copy(base);
+            worker.modelCopy.addRand(trialSeed, perturbation.sign * sigma, useFastNoise);
+        }
+        if (useFixedModel)
+        {
+            worker.fixedModel.copyWeights(worker.modelCopy);
+        }
+    };
+
+    // Plays a chunk of games of the worker's model copy from taskSeed, returns their total score
+    auto playChunk = [&](TrialWorker<gameSize, hiddenSize> &worker, int chunk, uint32_t taskSeed)
+    {
+        const int chunkGames = std::min(gamesPerChunk, itersPerTrial - chunk * gamesPerChunk);
+        HiddenAccumulator *workerAccumulatorPtr = useAccumulator ? &worker.accumulator : nullptr;
+        std::vector<HiddenAccumulator> *workerVecAccumulatorsPtr = useAccumulator ? &worker.vecAccumulators : nullptr;
+        float score;
+        if (useVecEnv)
+        {
+            worker.vecEnv.seed(taskSeed);
+        }
+        if (useVecEnv && useFixedModel)
+        {
+            score = testModelVec(game, worker.fixedModel, worker.vecLogits, worker.vecEnv, worker.vecActions, chunkGames, workerVecAccumulatorsPtr);
+        }
+        else if (useVecEnv)
+        {
+            score = testModelVec(game, worker.modelCopy, worker.vecLogits, worker.vecEnv, worker.vecActions, chunkGames, workerVecAccumulatorsPtr);
+        }
+        else if (useFixedModel)
+        {
+            score = testModel(game, worker.fixedModel, worker.out, taskSeed, chunkGames, appleTolerance, workerAccumulatorPtr);
+        }
+        else
+        {
+            score = testModel(game, worker.modelCopy, worker.out, taskSeed, chunkGames, appleTolerance, workerAccumulatorPtr);
+        }
+        return score * (float)chunkGames;
+    };
+
+    // Async mode: every pool thread keeps taking the next trial, copying the newest weights and playing all of its games,
+    // so a long game only holds up its own thread. The main thread steps once nTrials results are in. Each result
+    // records the version it was played against, and the last maxStaleness + 1 versions are kept to correct for it
+    std::mutex modelMutex; // Held while model.params and modelVersion change or are copied
+    int modelVersion = 0;
+    std::vector<Matrix> modelVersions(useAsync ? maxStaleness + 1 : 0, model.params); // Version v at v % (maxStaleness + 1)
+    std::mutex resultsMutex;
+    std::condition_variable resultsReady;
+    std::vector<AsyncTrialResult> asyncResults; // Pool to main thread, under resultsMutex
+    std::vector<AsyncTrialResult> pendingResults; // Taken by the main thread and not used yet
+    asyncResults.reserve(nTrials);
+    pendingResults.reserve(2 * nTrials);
+    std::atomic<bool> asyncRunning{false};
+    std::atomic<uint32_t> nextAsyncTrial{0};
+    std::vector<int> trialVersions(nTrials);
+    std::vector<float> importanceWeights(nTrials);
+    std::vector<float> versionWeights(modelVersions.size());
+    Matrix versionDelta = Matrix(1, model.getNumParams());
+
+    // Distributed mode, the coordinator waits here until every worker has connected and has its starting weights
+    EsHelloMessage hello;
+    hello.numParams = (uint32_t)model.getNumParams();
+    hello.nTrials = (uint32_t)nTrials;
+    hello.settingsCrc = crc32((const uint8_t *)config.data(), config.size());
+    std::unique_ptr<EsCoordinator> esCoordinator;
+    std::unique_ptr<EsWorker> esWorker;
+    if (isCoordinator)
+    {
+        const int numWorkers = std::stoi(argv[3]);
+        if (numWorkers < 1)
+        {
+            std::cerr << "The coordinator needs at least one worker" << std::endl;
+            return 1;
+        }
+        std::cout << "Waiting for " << numWorkers << " workers on port " << argv[2] << std::endl;
+        try
+        {
+            esCoordinator = std::make_unique<EsCoordinator>(std::stoi(argv[2]), numWorkers, hello, model.params, useAntithetic);
+        }
+        catch (const std::runtime_error &error)
+        {
+            std::cerr << error.what() << std::endl;
+            return 1;
+        }
+    }
+    else if (isWorker)
+    {
+        try
+        {
+            esWorker = std::make_unique<EsWorker>(argv[2], std::stoi(argv[3]), hello, model.params);
+        }
+        catch (const std::runtime_error &error)
+        {
+            std::cerr << error.what() << std::endl;
+            std::cerr << "Usage: train worker <host> <port> [numThreads], with a coordinator of the same build listening there" << std::endl;
+            return 1;
+        }
+        std::cout << "Connected to " << argv[2] << ":" << argv[3] << std::endl;
+    }
+    if (useThreadPool && !isCoordinator)
+    {
+        std::cout << "Playing trials on " << pool.numThreads << " threads" << std::endl;
+    }
+
     // Init tracker stuff
     int stepNum = 0;
 
     std::cout << "Model has " << model.getNumParams() << " parameters" << std::endl;
 
+    if (useAsync)
+    {
+        const int numParams = model.getNumParams();
+        const uint32_t asyncRandSeed = randSeed;
+        const uint32_t asyncGameRandSeed = gameRandSeed;
+        asyncRunning = true;
+        pool.start([&, numParams, asyncRandSeed, asyncGameRandSeed](int threadIndex)
+                   {
+                       TrialWorker<gameSize, hiddenSize> &worker = workers[threadIndex];
+                       while (asyncRunning)
+                       {
+                           const uint32_t trialId = nextAsyncTrial++;
+                           AsyncTrialResult result;
+                           result.trialSeed = PCG_Hash(asyncRandSeed ^ (trialId * 2654435761u));
+                           if (useNoiseTable)
+                           {
+                               uint32_t trialSeed = result.trialSeed;
+                               result.perturbation = noiseTable.samplePerturbation(trialSeed, numParams);
+                           }
+                           {
+                               std::lock_guard<std::mutex> lock(modelMutex);
+                               worker.base.copy(model.params);
+                               result.version = modelVersion;
+                           }
+
+                           // An antithetic pair plays both signs here, on the same games
+                           for (int sign = 0; sign < trialStride; sign++)
+                           {
+                               NoisePerturbation perturbation = result.perturbation;
+                               perturbation.sign = sign == 0 ? perturbation.sign : -perturbation.sign;
+                               perturbWorker(worker, worker.base, perturbation, result.trialSeed);
+                               float total = 0.0f;
+                               for (int chunk = 0; chunk < numChunks; chunk++)
+                               {
+                                   total += playChunk(worker, chunk, PCG_Hash(asyncGameRandSeed ^ ((trialId * numChunks + chunk) * 2654435761u)));
+                               }
+                               result.scores[sign] = total / (float)itersPerTrial;
+                           }
+
+                           {
+                               std::lock_guard<std::mutex> lock(resultsMutex);
+                               asyncResults.push_back(result);
+                           }
+                           resultsReady.notify_one();
+                       } });
+    }
+
     while (true)
     {
+#ifdef COUNT_ALLOCATIONS
+        // Check that a step does not touch the heap after warm-up
+        const uint64_t stepStartAllocations = getAllocationCount();
+#endif
+
         // Zero gradient
         grad.zeros();
 
         float meanScore = 0.0f;
-        uint32_t noiseSeed = randSeed;
+        float meanStaleness = 0.0f;
+        int numDropped = 0;
 
         std::cout << std::endl;
-        for (int i = 0; i < nTrials; i++)
+        if (useAsync)
+        {
+            // Fill the step's trials from the results in the order they came in, only the main thread changes modelVersion
+            int numFilled = 0;
+            size_t numTaken = 0;
+            while (numFilled < nTrials)
+            {
+                if (numTaken == pendingResults.size())
+                {
+                    std::unique_lock<std::mutex> lock(resultsMutex);
+                    resultsReady.wait(lock, [&]
+                                      { return !asyncResults.empty(); });
+                    pendingResults.insert(pendingResults.end(), asyncResults.begin(), asyncResults.end());
+                    asyncResults.clear();
+                }
+                const AsyncTrialResult &result = pendingResults[numTaken++];
+                if (modelVersion - result.version > maxStaleness)
+                {
+                    numDropped++;
+                    continue;
+                }
+                for (int sign = 0; sign < trialStride; sign++)
+                {
+                    const int i = numFilled + sign;
+                    trialSeeds[i] = result.trialSeed;
+                    perturbations[i] = result.perturbation;
+                    perturbations[i].sign = sign == 0 ? perturbations[i].sign : -perturbations[i].sign;
+                    trialVersions[i] = result.version;
+                    scores[i] = result.scores[sign];
+                    meanScore += scores[i];
+                }
+                meanStaleness += (float)(modelVersion - result.version);
+                numFilled += trialStride;
+            }
+            pendingResults.erase(pendingResults.begin(), pendingResults.begin() + numTaken);
+            meanStaleness /= (float)(nTrials / trialStride);
+        }
+        else if (useThreadPool)
         {
-            if (i % logInterval == 0)
+            // A worker takes the step's seeds and its trials from the coordinator, everything else plays them all
+            int trialBegin = 0;
+            int trialEnd = nTrials;
+            EsStepMessage step;
+            if (isWorker)
+            {
+                if (!esWorker->receiveStep(step))
+                {
+                    std::cout << "Coordinator has closed the connection" << std::endl;
+                    break;
+                }
+                stepNum = (int)step.stepNum;
+                trialBegin = (int)step.trialBegin;
+                trialEnd = (int)step.trialEnd;
+                randSeed = step.randSeed;
+                gameRandSeed = step.gameRandSeed;
+            }
+            const uint32_t stepRandSeed = randSeed;
+
+            for (int i = 0; i < nTrials; i++)
+            {
+                // The second trial of an antithetic pair mirrors the first
+                if (useAntithetic && i % 2 == 1)
+                {
+                    trialSeeds[i] = trialSeeds[i - 1];
+                    perturbations[i] = perturbations[i - 1];
+                    perturbations[i].sign = -perturbations[i].sign;
+                    continue;
+                }
+                trialSeeds[i] = PCG_Hash(randSeed ^ (uint32_t)(i * 2654435761u));
+                if (useNoiseTable)
+                {
+                    uint32_t trialSeed = trialSeeds[i];
+                    perturbations[i] = noiseTable.samplePerturbation(trialSeed, model.getNumParams());
+                }
+            }
+            randSeed = PCG_Hash(randSeed);
+            const uint32_t chunkSeed = gameRandSeed;
+            gameRandSeed = PCG_Hash(gameRandSeed);
+            for (TrialWorker<gameSize, hiddenSize> &worker : workers)
             {
-                clearLines(1);
-                std::cout << "Doing trial [" << i << "/" << nTrials << "]" << std::endl;
+                worker.trial = -1;
             }
 
-            // Add random noise to copy of model using sigma
-            modelCopy.copyWeights(model);
-            modelCopy.addRand(randSeed, sigma);
+            // Plays trials [begin, end) on the pool into scores
+            auto playTrials = [&](int begin, int end)
+            {
+                pool.runTasks((end - begin) * numChunks, [&](int threadIndex, int localTask)
+                              {
+                                  TrialWorker<gameSize, hiddenSize> &worker = workers[threadIndex];
+                                  const int task = begin * numChunks + localTask;
+                                  const int trial = task / numChunks;
+                                  const int chunk = task % numChunks;
+
+                                  // Chunks of a trial usually run back to back on one thread, only perturb again when the trial changes
+                                  if (worker.trial != trial)
+                                  {
+                                      perturbWorker(worker, model.params, perturbations[trial], trialSeeds[trial]);
+                                      worker.trial = trial;
+                                  }
+
+                                  // Both trials of an antithetic pair play the same games, so their score difference is down to the noise
+                                  const int gameTask = useAntithetic ? (trial / 2) * numChunks + chunk : task;
+                                  chunkScores[task] = playChunk(worker, chunk, PCG_Hash(chunkSeed ^ (uint32_t)(gameTask * 2654435761u))); });
+
+                // Sum in task order so the scores do not depend on which thread ran what
+                for (int i = begin; i < end; i++)
+                {
+                    float total = 0.0f;
+                    for (int chunk = 0; chunk < numChunks; chunk++)
+                    {
+                        total += chunkScores[i * numChunks + chunk];
+                    }
+                    scores[i] = total / (float)itersPerTrial;
+                }
+            };
+
+            if (isCoordinator)
+            {
+                esCoordinator->runStep(stepNum, stepRandSeed, chunkSeed, model.params, scores, playTrials);
+            }
+            else
+            {
+                playTrials(trialBegin, trialEnd);
 
-            // Test model
-            const float score = testModel(game, modelCopy, out, gameRandSeed, itersPerTrial, appleTolerance);
-            scores[i] = score;
-            meanScore += score;
+                if (isWorker && !esWorker->exchangeScores(step, model.params, scores, nTrials))
+                {
+                    std::cout << "Coordinator has closed the connection" << std::endl;
+                    break;
+                }
+            }
+            for (int i = 0; i < nTrials; i++)
+            {
+                meanScore += scores[i];
+            }
+        }
+        else
+        {
+            for (int i = 0; i < nTrials; i++)
+            {
+                if (i % logInterval == 0)
+                {
+                    clearLines(1);
+                    std::cout << "Doing trial [" << i << "/" << nTrials << "]" << std::endl;
+                }
+
+                // Add random noise to copy of model using sigma
+                if (useAntithetic && i % 2 == 1)
+                {
+                    // Mirror the previous trial's noise
+                    trialSeeds[i] = trialSeeds[i - 1];
+                    perturbations[i] = perturbations[i - 1];
+                    perturbations[i].sign = -perturbations[i].sign;
+                    if (useNoiseTable)
+                    {
+                        noiseTable.perturb(model.params, modelCopy.params, perturbations[i], sigma);
+                    }
+                    else
+                    {
+                        uint32_t mirrorSeed = trialSeeds[i];
+                        modelCopy.copyWeights(model);
+                        modelCopy.addRand(mirrorSeed, -sigma, useFastNoise);
+                    }
+                }
+                else if (useNoiseTable)
+                {
+                    perturbations[i] = noiseTable.samplePerturbation(randSeed, model.getNumParams());
+                    noiseTable.perturb(model.params, modelCopy.params, perturbations[i], sigma);
+                }
+                else
+                {
+                    trialSeeds[i] = randSeed;
+                    modelCopy.copyWeights(model);
+                    modelCopy.addRand(randSeed, sigma, useFastNoise);
+                }
+
+                // Both trials of an antithetic pair play the same games, as gameTask gives them on the pool
+                if (useAntithetic && i % 2 == 0)
+                {
+                    pairGameRandSeed = gameRandSeed;
+                    pairVecSeeds = vecEnv.randSeeds;
+                }
+                else if (useAntithetic)
+                {
+                    gameRandSeed = pairGameRandSeed;
+                    vecEnv.randSeeds = pairVecSeeds;
+                }
+
+                // Test model
+                float score;
+                if (useFixedModel)
+                {
+                    fixedModel.copyWeights(modelCopy);
+                }
+                if (useVecEnv && useFixedModel)
+                {
+                    score = testModelVec(game, fixedModel, vecLogits, vecEnv, vecActions, itersPerTrial, vecAccumulatorsPtr);
+                }
+                else if (useVecEnv)
+                {
+                    score = testModelVec(game, modelCopy, vecLogits, vecEnv, vecActions, itersPerTrial, vecAccumulatorsPtr);
+                }
+                else if (useFixedModel)
+                {
+                    score = testModel(game, fixedModel, out, gameRandSeed, itersPerTrial, appleTolerance, accumulatorPtr);
+                }
+                else
+                {
+                    score = testModel(game, modelCopy, out, gameRandSeed, itersPerTrial, appleTolerance, accumulatorPtr);
+                }
+                scores[i] = score;
+                meanScore += score;
+            }
         }
 
         // Get mean and std
+        // Antithetic pairs play the same games, so their std comes from half the score difference within each pair,
+        // the spread between pairs is down to the games rather than the noise
         meanScore /= (float)nTrials;
         float std = 0.0f;
         for (int i = 0; i < nTrials; i++)
         {
-            const float x = scores[i] - meanScore;
+            const float x = useAntithetic ? 0.5f * (scores[i - i % 2] - scores[i - i % 2 + 1]) : scores[i] - meanScore;
             std += x * x;
         }
         std = sqrt(std / (float)nTrials);
-        const float invStd = 1.0f / std;
+        const float invStd = std > 0.0f ? 1.0f / std : 0.0f; // Every trial scoring the same gives no gradient
 
         clearLines(1);
         std::cout << "Step " << stepNum << ", Avg. Score: " << meanScore << std::endl;
+        if (useAsync)
+        {
+            std::cout << "Mean staleness: " << meanStaleness << ", Dropped trials: " << numDropped << std::endl;
+        }
 
         // Normalize scores and update gradient
-        for (int i = 0; i < nTrials; i++)
+        // An antithetic pair's noise is this trial's noise and its negative, so the pair adds once with the difference
+        // of its normalized scores
+        for (int i = 0; i < nTrials; i += trialStride)
+        {
+            trialWeights[i] = useAntithetic ? (scores[i] - scores[i + 1]) * invStd : (scores[i] - meanScore) * invStd;
+        }
+
+        // Async trials played against older weights x = old + sigma * eps are importance weighted to the current weights.
+        // With delta = old - current, x is exp(-eps . delta / sigma - |delta|^2 / (2 sigma^2)) times as likely around the
+        // current weights, and its step from them is sigma * eps + delta, so each stale trial adds its delta to grad too,
+        // summed by version. Weights are normalized to a mean of 1 over the step, fresh trials have a weight of 1 before that
+        if (useAsync)
+        {
+            for (int i = 0; i < nTrials; i += trialStride)
+            {
+                float epsDelta = 0.0f;
+                float deltaSquared = 0.0f;
+                if (trialVersions[i] != modelVersion)
+                {
+                    versionDelta.copy(modelVersions[trialVersions[i] % modelVersions.size()]);
+                    versionDelta.sub(model.params);
+                    deltaSquared = versionDelta.normSquared();
+                    if (useNoiseTable)
+                    {
+                        epsDelta = noiseTable.dot(perturbations[i], versionDelta);
+                    }
+                    else
+                    {
+                        uint32_t trialSeed = trialSeeds[i];
+                        modelCopy.setRand(trialSeed, 1.0f, useFastNoise);
+                        epsDelta = modelCopy.params.dot(versionDelta);
+                    }
+                }
+                for (int sign = 0; sign < trialStride; sign++)
+                {
+                    importanceWeights[i + sign] = (sign == 0 ? -epsDelta : epsDelta) / sigma - deltaSquared / (2.0f * sigma * sigma);
+                }
+            }
+            const float maxLogWeight = *std::max_element(importanceWeights.begin(), importanceWeights.end());
+            float weightSum = 0.0f;
+            for (int i = 0; i < nTrials; i++)
+            {
+                importanceWeights[i] = std::exp(importanceWeights[i] - maxLogWeight);
+                weightSum += importanceWeights[i];
+            }
+
+            // A pair's trialWeight is twice its centred score z, its noise adds z * (w+ + w-) and its delta z * (w+ - w-)
+            std::fill(versionWeights.begin(), versionWeights.end(), 0.0f);
+            for (int i = 0; i < nTrials; i += trialStride)
+            {
+                const float weightPlus = importanceWeights[i] * (float)nTrials / weightSum;
+                const float weightMinus = useAntithetic ? importanceWeights[i + 1] * (float)nTrials / weightSum : 0.0f;
+                const float deltaWeight = useAntithetic ? 0.5f * trialWeights[i] * (weightPlus - weightMinus) : trialWeights[i] * weightPlus;
+                trialWeights[i] *= useAntithetic ? 0.5f * (weightPlus + weightMinus) : weightPlus;
+                if (trialVersions[i] != modelVersion)
+                {
+                    versionWeights[trialVersions[i] % modelVersions.size()] += deltaWeight;
+                }
+            }
+        }
+
+        // The async trials keep the pool busy, so their gradient is built here
+        if (useSlicedGradient && !useAsync && (useNoiseTable || useFastNoise))
+        {
+            // Each task owns a slice of grad and adds every trial's noise for it in trial order, so the sums do not depend
+            // on the thread count and no trial needs a whole model of noise
+            const int numParams = grad.numValues;
+            pool.runTasks((numParams + gradientSliceSize - 1) / gradientSliceSize, [&](int, int slice)
+                          {
+                              const int start = slice * gradientSliceSize;
+                              const int stop = std::min(start + gradientSliceSize, numParams);
+                              for (int i = 0; i < nTrials; i += trialStride)
+                              {
+                                  if (useNoiseTable)
+                                  {
+                                      noiseTable.addNoise(grad, perturbations[i], sigma * trialWeights[i], start, stop);
+                                  }
+                                  else
+                                  {
+                                      grad.addFastRandRange(trialSeeds[i], sigma * trialWeights[i], start, stop);
+                                  }
+                              } });
+        }
+        else
+        {
+            for (int i = 0; i < nTrials; i += trialStride)
+            {
+                if (useNoiseTable)
+                {
+                    noiseTable.addNoise(grad, perturbations[i], sigma * trialWeights[i]);
+                }
+                else
+                {
+                    uint32_t trialSeed = trialSeeds[i];
+                    modelCopy.setRand(trialSeed, sigma, useFastNoise); // Get just the noise, not weights + noise
+                    grad.addScaled(modelCopy.params, trialWeights[i]);
+                }
+            }
+        }
+        for (size_t v = 0; v < versionWeights.size(); v++)
         {
-            const float scoreVal = (scores[i] - meanScore) * invStd;
-            modelCopy.setRand(noiseSeed, sigma); // Get just the noise, not weights + noise
-            modelCopy.weight0.mul(scoreVal);
-            modelCopy.weight1.mul(scoreVal);
-            modelCopy.weight2.mul(scoreVal);
-            int gradStart = 0;
-            grad.addOther(modelCopy.weight0, gradStart, modelCopy.weight0.numValues);
-            gradStart += modelCopy.weight0.numValues;
-            grad.addOther(modelCopy.weight1, gradStart, gradStart + modelCopy.weight1.numValues);
-            gradStart += modelCopy.weight1.numValues;
-            grad.addOther(modelCopy.weight2, gradStart, gradStart + modelCopy.weight2.numValues);
+            if (versionWeights[v] != 0.0f)
+            {
+                grad.addScaled(modelVersions[v], versionWeights[v]);
+                grad.addScaled(model.params, -versionWeights[v]);
+            }
         }
 
         // Finalize gradient with optimizer
@@ -235,30 +945,50 @@ int main()
             grad.mul(mulVal);
         }
 
-        // Update model using gradient
-        int gradStart = 0;
-        model.weight0.otherAdd(grad, gradStart, gradStart + model.weight0.numValues);
-        gradStart += modelCopy.weight0.numValues;
-        model.weight1.otherAdd(grad, gradStart, gradStart + modelCopy.weight1.numValues);
-        gradStart += modelCopy.weight1.numValues;
-        model.weight2.otherAdd(grad, gradStart, gradStart + modelCopy.weight2.numValues);
+        // Update model using gradient, async pool threads copy the weights between updates
+        {
+            std::lock_guard<std::mutex> lock(modelMutex);
+            model.params.add(grad);
+            modelVersion++;
+        }
+        if (useAsync)
+        {
+            modelVersions[modelVersion % modelVersions.size()].copy(model.params);
+        }
+
+        // A worker's copy only has to keep up, the coordinator reports, tests, logs and saves
+        if (isWorker)
+        {
+            stepNum++;
+            continue;
+        }
 
         // Print grad norm
         float norm = sqrt(grad.normSquared());
         std::cout << "Grad Norm: " << norm << std::endl;
 
         // Print distance from starting weights
-        float dist = model.weight0.diffSquared(originalModel.weight0) + model.weight1.diffSquared(originalModel.weight1) + model.weight2.diffSquared(originalModel.weight2);
+        float dist = model.params.diffSquared(originalModel.params);
         dist = sqrt(dist);
         std::cout << "Current weights distance from starting weights: " << dist << std::endl;
 
         // Test updated model
         uint32_t testGameSeed = 42;
-        const float testScore = testModel(game, model, out, testGameSeed, itersPerTrial, appleTolerance);
-        std::cout << "Model Score: " << testScore << "\n\n";
+        const float testScore = testModel(game, model, out, testGameSeed, itersPerTrial, appleTolerance, accumulatorPtr);
+        std::cout << "Model Score: " << testScore;
+        if (policy.isLoaded())
+        {
+            std::cout << " (optimal policy " << policy.header->optimalScore << " with no step limit, the model score stops after " << appleTolerance
+                      << " steps without an apple)";
+        }
+        std::cout << "\n";
+#ifdef COUNT_ALLOCATIONS
+        std::cout << "Heap allocations: " << getAllocationCount() - stepStartAllocations << "\n";
+#endif
+        std::cout << "\n";
 
         // Log
-        std::ofstream logFile(currentTrainingRunPath + "/log.txt", std::ios::app); // Open in append mode
+        std::ofstream logFile(logPath, std::ios::app); // Open in append mode
         if (logFile.is_open())
         {
             logFile << testScore << " ";
@@ -272,5 +1002,9 @@ int main()
         model.saveToFile(savePath);
     }
 
+    // Let the async trials being played finish before the pool goes
+    asyncRunning = false;
+    pool.wait();
+
     return 0;
 }
\ No newline at end of file
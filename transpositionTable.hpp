@@ -0,0 +1,154 @@
+#ifndef TRANSPOSITION_TABLE_HPP
+#define TRANSPOSITION_TABLE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*
+Fixed-size transposition table keyed by the Zobrist hash of a position (see zobrist.hpp).
+
+Each entry holds a mean value and a visit count for one position. Entries live in buckets of two:
+a position is stored in whichever slot of its bucket already holds it, or else replaces the slot
+with fewer visits, so well explored positions survive longer than one-off ones.
+
+The table is shared between threads without locks. An entry is two 64-bit atomics, the packed
+data and key ^ data. A reader only accepts an entry whose two words XOR back to its key, so a
+write torn by another thread reads as a miss instead of as someone else's value. Concurrent
+updates to the same position can lose a sample, which is fine for value estimates.
+*/
+
+struct TranspositionTable
+{
+    struct Entry
+    {
+        std::atomic<uint64_t> check{0}; // key ^ data
+        std::atomic<uint64_t> data{0};  // Mean value bits in the low 32 bits, visit count in the high 32 bits
+    };
+
+    std::vector<Entry> entries;
+    uint64_t bucketMask;
+
+    // numEntries is rounded up to a power of two
+    TranspositionTable(int numEntries = 1 << 20)
+    {
+        int roundedEntries = 2;
+        while (roundedEntries < numEntries)
+        {
+            roundedEntries *= 2;
+        }
+        entries = std::vector<Entry>(roundedEntries);
+        bucketMask = (uint64_t)(roundedEntries / 2 - 1);
+    }
+
+    TranspositionTable(const TranspositionTable &) = delete;
+    TranspositionTable &operator=(const TranspositionTable &) = delete;
+
+    static uint64_t pack(float value, int visits)
+    {
+        uint32_t valueBits;
+        std::memcpy(&valueBits, &value, sizeof(valueBits));
+        return ((uint64_t)(uint32_t)visits << 32) | valueBits;
+    }
+
+    static void unpack(uint64_t data, float &value, int &visits)
+    {
+        const uint32_t valueBits = (uint32_t)data;
+        std::memcpy(&value, &valueBits, sizeof(value));
+        visits = (int)(data >> 32);
+    }
+
+    Entry *getBucket(uint64_t key)
+    {
+        return &entries[(key & bucketMask) * 2];
+    }
+
+    // Slot of the bucket holding key, or nullptr. data is set to the slot's data when found
+    Entry *find(uint64_t key, uint64_t &data)
+    {
+        Entry *bucket = getBucket(key);
+        for (int i = 0; i < 2; i++)
+        {
+            data = bucket[i].data.load(std::memory_order_relaxed);
+            const uint64_t check = bucket[i].check.load(std::memory_order_relaxed);
+            if ((check ^ data) == key && data != 0)
+            {
+                return &bucket[i];
+            }
+        }
+        return nullptr;
+    }
+
+    void write(Entry *entry, uint64_t key, uint64_t data)
+    {
+        entry->data.store(data, std::memory_order_relaxed);
+        entry->check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+    // Returns false if the position is not in the table
+    bool probe(uint64_t key, float &value, int &visits)
+    {
+        uint64_t data;
+        if (find(key, data) == nullptr)
+        {
+            return false;
+        }
+        unpack(data, value, visits);
+        return true;
+    }
+
+    // Overwrite the entry for key
+    void store(uint64_t key, float value, int visits)
+    {
+        uint64_t data;
+        Entry *entry = find(key, data);
+        if (entry == nullptr)
+        {
+            entry = getVictim(key);
+        }
+        write(entry, key, pack(value, visits));
+    }
+
+    // Add visits samples with mean value to the running mean for key
+    void update(uint64_t key, float value, int visits = 1)
+    {
+        uint64_t data;
+        Entry *entry = find(key, data);
+        if (entry == nullptr)
+        {
+            write(getVictim(key), key, pack(value, visits));
+            return;
+        }
+
+        float oldValue;
+        int oldVisits;
+        unpack(data, oldValue, oldVisits);
+        const int newVisits = oldVisits + visits;
+        const float newValue = oldValue + (value - oldValue) * (float)visits / (float)newVisits;
+        write(entry, key, pack(newValue, newVisits));
+    }
+
+    // Slot to replace when key is not in its bucket: the one with fewer visits
+    Entry *getVictim(uint64_t key)
+    {
+        Entry *bucket = getBucket(key);
+        float value;
+        int visits0;
+        int visits1;
+        unpack(bucket[0].data.load(std::memory_order_relaxed), value, visits0);
+        unpack(bucket[1].data.load(std::memory_order_relaxed), value, visits1);
+        return visits1 < visits0 ? &bucket[1] : &bucket[0];
+    }
+
+    void clear()
+    {
+        for (Entry &entry : entries)
+        {
+            entry.check.store(0, std::memory_order_relaxed);
+            entry.data.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,369 @@
+#ifndef VEC_ENV_HPP
+#define VEC_ENV_HPP
+
+#include <cstdint>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define VEC_ENV_X86
+#endif
+
+#include "fixedGame.hpp"
+
+/*
+Runs numGames FixedSnakeGame<N> games in lockstep.
+
+Every per-game field is stored as its own array (structure of arrays) so one call to step() can
+check walls, apples and self collisions for 8 games at a time with AVX2. Each game has its own
+RNG stream and plays a quota of episodes: when an episode ends the game is reset from the root
+state given to reset(), and once its quota is used up the game goes inactive.
+*/
+
+template <int N>
+struct VecSnakeEnv
+{
+    static constexpr int numCells = FixedSnakeGame<N>::numCells;
+    static constexpr int bodyCapacity = FixedSnakeGame<N>::bodyCapacity;
+    static constexpr int bodyMask = FixedSnakeGame<N>::bodyMask;
+
+    int numGames;
+    int appleTolerance;
+
+    // Per game state
+    std::vector<int32_t> headRows;
+    std::vector<int32_t> headCols;
+    std::vector<int32_t> tails;
+    std::vector<int32_t> directions;
+    std::vector<int32_t> apples;
+    std::vector<int32_t> scores;
+    std::vector<int32_t> stepCounts;
+    std::vector<int32_t> lastAppleSteps;
+    std::vector<uint64_t> occupied;
+    std::vector<uint8_t> bodies; // numGames * bodyCapacity ring buffers, same layout as FixedSnakeGame::body
+    std::vector<int32_t> bodyStarts;
+    std::vector<int32_t> bodyLengths;
+    std::vector<uint8_t> freeCells; // numGames * numCells free cell sets, same layout as FixedSnakeGame::freeCells
+    std::vector<uint8_t> freeIndex;
+    std::vector<int32_t> numFree;
+    std::vector<uint8_t> done;   // 1 if the game finished an episode on the last step
+    std::vector<uint8_t> active; // 0 once the game has played all of its episodes
+    std::vector<int32_t> episodesLeft;
+    std::vector<uint32_t> randSeeds;
+    std::vector<uint8_t> boards; // numGames * numCells board views for SnakeModel::forward
+
+    // Scratch written by the vectorized checks
+    std::vector<int32_t> newRows;
+    std::vector<int32_t> newCols;
+    std::vector<int32_t> newHeads;
+    std::vector<int32_t> died;
+    std::vector<int32_t> ateApple;
+    std::vector<int32_t> leftTails; // Cell the tail left on the last step, for games that moved without eating
+
+    // Root state every episode starts from (apart from the apple)
+    FixedSnakeGame<N> rootGame;
+
+    int numActive = 0;
+    int episodesFinished = 0;
+    float totalScore = 0.0f;
+
+    VecSnakeEnv(int _numGames, uint32_t randSeed, int _appleTolerance = N * N)
+        : headRows(_numGames), headCols(_numGames), tails(_numGames), directions(_numGames),
+          apples(_numGames), scores(_numGames), stepCounts(_numGames), lastAppleSteps(_numGames),
+          occupied(_numGames), bodies(_numGames * bodyCapacity), bodyStarts(_numGames), bodyLengths(_numGames),
+          freeCells(_numGames * numCells), freeIndex(_numGames * numCells), numFree(_numGames),
+          done(_numGames), active(_numGames), episodesLeft(_numGames), randSeeds(_numGames),
+          boards(_numGames * numCells),
+          newRows(_numGames), newCols(_numGames), newHeads(_numGames), died(_numGames), ateApple(_numGames), leftTails(_numGames),
+          rootGame(randSeed)
+    {
+        numGames = _numGames;
+        appleTolerance = _appleTolerance;
+        seed(randSeed);
+    }
+
+    // Give every game its own stream
+    void seed(uint32_t randSeed)
+    {
+        for (int i = 0; i < numGames; i++)
+        {
+            randSeeds[i] = PCG_Hash(randSeed ^ (uint32_t)(i * 2654435761u));
+        }
+    }
+
+    // Start numEpisodes episodes from root, spread as evenly as possible over the games
+    void reset(const FixedSnakeGame<N> &root, int numEpisodes)
+    {
+        rootGame.copyState(root);
+        numActive = 0;
+        episodesFinished = 0;
+        totalScore = 0.0f;
+        for (int i = 0; i < numGames; i++)
+        {
+            episodesLeft[i] = numEpisodes / numGames + (i < numEpisodes % numGames ? 1 : 0);
+            active[i] = episodesLeft[i] > 0;
+            done[i] = 0;
+            if (active[i])
+            {
+                resetGame(i);
+                numActive++;
+            }
+        }
+    }
+
+    void resetGame(int i)
+    {
+        headRows[i] = rootGame.snakeHeadPosition / N;
+        headCols[i] = rootGame.snakeHeadPosition % N;
+        directions[i] = rootGame.snakeDirection;
+        scores[i] = rootGame.score;
+        stepCounts[i] = 0;
+        lastAppleSteps[i] = 0;
+        occupied[i] = rootGame.occupied;
+        uint8_t *body = &bodies[i * bodyCapacity];
+        for (int j = 0; j < rootGame.bodyLength; j++)
+        {
+            body[j] = rootGame.body[(rootGame.bodyStart + j) & bodyMask];
+        }
+        bodyStarts[i] = 0;
+        bodyLengths[i] = rootGame.bodyLength;
+        tails[i] = body[0];
+        for (int j = 0; j < numCells; j++)
+        {
+            freeCells[i * numCells + j] = rootGame.freeCells[j];
+            freeIndex[i * numCells + j] = rootGame.freeIndex[j];
+        }
+        numFree[i] = rootGame.numFree;
+        randomizeApplePosition(i);
+    }
+
+    void randomizeApplePosition(int i)
+    {
+#ifdef SNAKE_LEGACY_APPLE_PLACEMENT
+        int applePosition = randInt(randSeeds[i], numCells);
+        while ((occupied[i] >> applePosition) & 1)
+        {
+            applePosition = randInt(randSeeds[i], numCells);
+        }
+        apples[i] = applePosition;
+#else
+        apples[i] = freeCells[i * numCells + randInt(randSeeds[i], numFree[i])];
+#endif
+    }
+
+    void removeFree(int i, int position)
+    {
+        uint8_t *cells = &freeCells[i * numCells];
+        uint8_t *index = &freeIndex[i * numCells];
+        const int slot = index[position];
+        const int last = cells[numFree[i] - 1];
+        cells[slot] = last;
+        index[last] = slot;
+        numFree[i]--;
+    }
+
+    void addFree(int i, int position)
+    {
+        freeCells[i * numCells + numFree[i]] = position;
+        freeIndex[i * numCells + position] = numFree[i];
+        numFree[i]++;
+    }
+
+    const uint8_t *getBoard(int i)
+    {
+        uint8_t *board = &boards[i * numCells];
+        const uint8_t *body = &bodies[i * bodyCapacity];
+        for (int j = 0; j < numCells; j++)
+        {
+            board[j] = 0;
+        }
+        for (int j = 0; j < bodyLengths[i]; j++)
+        {
+            board[body[(bodyStarts[i] + j) & bodyMask]] = j + 1;
+        }
+        return board;
+    }
+
+    // Wall, apple and self collision checks for games [start, stop), one game at a time
+    void checkMovesScalar(const int32_t *actions, int start, int stop)
+    {
+        for (int i = start; i < stop; i++)
+        {
+            const int32_t turn = actions[i] == SnakeActions::TURN_LEFT ? 3 : (actions[i] == SnakeActions::TURN_RIGHT ? 1 : 0);
+            const int32_t direction = (directions[i] + turn) & 3;
+            const int32_t dx = (direction == SnakeDirections::RIGHT) - (direction == SnakeDirections::LEFT);
+            const int32_t dy = (direction == SnakeDirections::DOWN) - (direction == SnakeDirections::UP);
+            const int32_t row = headRows[i] + dy;
+            const int32_t col = headCols[i] + dx;
+            const int32_t head = row * N + col;
+            const bool hitWall = (uint32_t)row >= (uint32_t)N || (uint32_t)col >= (uint32_t)N;
+            const bool hitSnake = ((occupied[i] >> (head & 63)) & 1) && head != tails[i];
+            directions[i] = direction;
+            newRows[i] = row;
+            newCols[i] = col;
+            newHeads[i] = head;
+            died[i] = hitWall || hitSnake;
+            ateApple[i] = head == apples[i];
+        }
+    }
+
+#ifdef VEC_ENV_X86
+    // Same as checkMovesScalar, 8 games at a time
+    __attribute__((target("avx2"))) void checkMovesAVX2(const int32_t *actions, int stop)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i three = _mm256_set1_epi32(3);
+        const __m256i sizeMinusOne = _mm256_set1_epi32(N - 1);
+        const __m256i sizeVec = _mm256_set1_epi32(N);
+        const __m256i mask63 = _mm256_set1_epi32(63);
+        const __m256i oneWide = _mm256_set1_epi64x(1);
+        const __m256i lowHalves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+        for (int i = 0; i < stop; i += 8)
+        {
+            // Turn: TURN_LEFT (0) adds 3, TURN_RIGHT (1) adds 1, NO_TURN adds 0
+            const __m256i action = _mm256_loadu_si256((const __m256i *)&actions[i]);
+            const __m256i turnLeft = _mm256_and_si256(_mm256_cmpeq_epi32(action, zero), three);
+            const __m256i turnRight = _mm256_and_si256(_mm256_cmpeq_epi32(action, one), one);
+            __m256i direction = _mm256_loadu_si256((const __m256i *)&directions[i]);
+            direction = _mm256_and_si256(_mm256_add_epi32(direction, _mm256_or_si256(turnLeft, turnRight)), three);
+
+            // Compares give -1 for true, so dx = (dir == LEFT) - (dir == RIGHT) is -1 for LEFT and 1 for RIGHT
+            const __m256i dx = _mm256_sub_epi32(_mm256_cmpeq_epi32(direction, _mm256_set1_epi32(SnakeDirections::LEFT)),
+                                                _mm256_cmpeq_epi32(direction, _mm256_set1_epi32(SnakeDirections::RIGHT)));
+            const __m256i dy = _mm256_sub_epi32(_mm256_cmpeq_epi32(direction, _mm256_set1_epi32(SnakeDirections::UP)),
+                                                _mm256_cmpeq_epi32(direction, _mm256_set1_epi32(SnakeDirections::DOWN)));
+            const __m256i row = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)&headRows[i]), dy);
+            const __m256i col = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)&headCols[i]), dx);
+            const __m256i head = _mm256_add_epi32(_mm256_mullo_epi32(row, sizeVec), col);
+
+            // Walls
+            __m256i hitWall = _mm256_or_si256(_mm256_cmpgt_epi32(zero, row), _mm256_cmpgt_epi32(row, sizeMinusOne));
+            hitWall = _mm256_or_si256(hitWall, _mm256_or_si256(_mm256_cmpgt_epi32(zero, col), _mm256_cmpgt_epi32(col, sizeMinusOne)));
+
+            // Self collisions, test the head bit of each game's bitboard 4 games at a time
+            const __m256i shift = _mm256_and_si256(head, mask63);
+            const __m256i bitsLow = _mm256_and_si256(_mm256_srlv_epi64(_mm256_loadu_si256((const __m256i *)&occupied[i]),
+                                                                       _mm256_cvtepi32_epi64(_mm256_castsi256_si128(shift))),
+                                                     oneWide);
+            const __m256i bitsHigh = _mm256_and_si256(_mm256_srlv_epi64(_mm256_loadu_si256((const __m256i *)&occupied[i + 4]),
+                                                                        _mm256_cvtepi32_epi64(_mm256_extracti128_si256(shift, 1))),
+                                                      oneWide);
+            const __m256i bits = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(bitsLow, lowHalves),
+                                                    _mm256_permutevar8x32_epi32(bitsHigh, lowHalves), 0xF0);
+            const __m256i notTail = _mm256_xor_si256(_mm256_cmpeq_epi32(head, _mm256_loadu_si256((const __m256i *)&tails[i])),
+                                                     _mm256_set1_epi32(-1));
+            const __m256i hitSnake = _mm256_and_si256(_mm256_cmpeq_epi32(bits, one), notTail);
+
+            // Apples
+            const __m256i apple = _mm256_cmpeq_epi32(head, _mm256_loadu_si256((const __m256i *)&apples[i]));
+
+            _mm256_storeu_si256((__m256i *)&directions[i], direction);
+            _mm256_storeu_si256((__m256i *)&newRows[i], row);
+            _mm256_storeu_si256((__m256i *)&newCols[i], col);
+            _mm256_storeu_si256((__m256i *)&newHeads[i], head);
+            _mm256_storeu_si256((__m256i *)&died[i], _mm256_and_si256(_mm256_or_si256(hitWall, hitSnake), one));
+            _mm256_storeu_si256((__m256i *)&ateApple[i], _mm256_and_si256(apple, one));
+        }
+    }
+#endif
+
+    void checkMoves(const int32_t *actions)
+    {
+        int start = 0;
+#ifdef VEC_ENV_X86
+        static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+        if (hasAVX2)
+        {
+            start = numGames - numGames % 8;
+            checkMovesAVX2(actions, start);
+        }
+#endif
+        checkMovesScalar(actions, start, numGames);
+    }
+
+    void endEpisode(int i)
+    {
+        totalScore += scores[i];
+        episodesFinished++;
+        episodesLeft[i]--;
+        done[i] = 1;
+        if (episodesLeft[i] > 0)
+        {
+            resetGame(i);
+        }
+        else
+        {
+            active[i] = 0;
+            numActive--;
+        }
+    }
+
+    // Take one step in every active game, actions[i] is a SnakeActions value for game i
+    void step(const int32_t *actions)
+    {
+        checkMoves(actions);
+
+        for (int i = 0; i < numGames; i++)
+        {
+            done[i] = 0;
+            if (!active[i])
+            {
+                continue;
+            }
+
+            if (died[i])
+            {
+                endEpisode(i);
+                continue;
+            }
+
+            const int head = newHeads[i];
+            uint8_t *body = &bodies[i * bodyCapacity];
+            headRows[i] = newRows[i];
+            headCols[i] = newCols[i];
+
+            if (ateApple[i])
+            {
+                scores[i]++;
+                lastAppleSteps[i] = stepCounts[i];
+                stepCounts[i]++;
+
+                // Got max score
+                if (scores[i] + 2 == numCells)
+                {
+                    endEpisode(i);
+                    continue;
+                }
+
+                body[(bodyStarts[i] + bodyLengths[i]) & bodyMask] = head;
+                bodyLengths[i]++;
+                occupied[i] |= (uint64_t)1 << head;
+                removeFree(i, head);
+                randomizeApplePosition(i);
+            }
+            else
+            {
+                leftTails[i] = tails[i];
+                occupied[i] &= ~((uint64_t)1 << tails[i]);
+                addFree(i, tails[i]);
+                bodyStarts[i] = (bodyStarts[i] + 1) & bodyMask;
+                body[(bodyStarts[i] + bodyLengths[i] - 1) & bodyMask] = head;
+                occupied[i] |= (uint64_t)1 << head;
+                removeFree(i, head);
+                tails[i] = body[bodyStarts[i]];
+
+                // Have gone appleTolerance steps without getting an apple, so stop
+                const bool outOfTime = stepCounts[i] - lastAppleSteps[i] > appleTolerance;
+                stepCounts[i]++;
+                if (outOfTime)
+                {
+                    endEpisode(i);
+                }
+            }
+        }
+    }
+};
+
+#endif
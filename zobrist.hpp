@@ -0,0 +1,56 @@
+#ifndef ZOBRIST_HPP
+#define ZOBRIST_HPP
+
+#include <cstdint>
+
+/*
+Zobrist keys for snake positions.
+
+A position is hashed as the XOR of:
+- one link key per body cell except the head, for (cell, direction to the next cell towards the head)
+- the head cell
+- the apple cell
+- the direction the snake is facing
+
+The links pin down the order of the body, not just which cells are covered, so two positions only
+share a hash when they play out the same. Each step changes a handful of terms, so games keep the
+hash up to date in O(1). Keys are mixed from the term instead of read from a table, so any board
+size works and SnakeGame and FixedSnakeGame<N> hash the same position to the same value.
+*/
+
+// SplitMix64 finalizer
+constexpr uint64_t zobristMix(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+constexpr uint64_t zobristLinkKey(int position, int direction)
+{
+    return zobristMix(((uint64_t)1 << 32) | ((uint64_t)position << 2) | (uint64_t)direction);
+}
+
+constexpr uint64_t zobristHeadKey(int position)
+{
+    return zobristMix(((uint64_t)2 << 32) | (uint64_t)position);
+}
+
+constexpr uint64_t zobristAppleKey(int position)
+{
+    return zobristMix(((uint64_t)3 << 32) | (uint64_t)position);
+}
+
+constexpr uint64_t zobristDirectionKey(int direction)
+{
+    return zobristMix(((uint64_t)4 << 32) | (uint64_t)direction);
+}
+
+// Direction of the move from one cell to a neighboring cell on a size x size board (0 = LEFT, 1 = UP, 2 = RIGHT, 3 = DOWN)
+constexpr int zobristLinkDirection(int from, int to, int size)
+{
+    return to == from - 1 ? 0 : (to == from - size ? 1 : (to == from + 1 ? 2 : 3));
+}
+
+#endif